@@ -72,6 +72,9 @@ static struct msm_platform_core_capability core_data_anorak[] = {
 	{HW_RESPONSE_TIMEOUT, HW_RESPONSE_TIMEOUT_VALUE}, /* 1000 ms */
 	{SW_PC_DELAY,         SW_PC_DELAY_VALUE        }, /* 1500 ms (>HW_RESPONSE_TIMEOUT)*/
 	{FW_UNLOAD_DELAY,     FW_UNLOAD_DELAY_VALUE    }, /* 3000 ms (>SW_PC_DELAY)*/
+	{FW_PRELOAD, 1},
+	{FW_KEEP_WARM, MSM_VIDC_FW_WARM_DELAY},
+	{FW_KEEP_WARM_MAX, 60000}, /* ms */
 	// TODO: review below entries, and if required rename as PREFETCH
 	{PREFIX_BUF_COUNT_PIX, 18},
 	{PREFIX_BUF_SIZE_PIX, 13434880}, /* Calculated by VIDEO_RAW_BUFFER_SIZE for 4096x2160 UBWC */
@@ -89,6 +92,24 @@ static struct msm_platform_core_capability core_data_anorak[] = {
 	{DCVS, 1},
 	{DECODE_BATCH, 1},
 	{DECODE_BATCH_TIMEOUT, 200},
+	{ENCODE_BATCH_FPS, 120},
+	{ENCODE_BATCH_TIMEOUT, 16},
+	{CMDQ_BACKLOG_SIZE, 32},
+	{CMDQ_BACKLOG_TIMEOUT, 2}, /* ms */
+	{IRQ_POLL_MSG_RATE, 3000}, /* msgs per sec */
+	{IRQ_POLL_BUDGET, 4},
+	{IRQ_POLL_INTERVAL_US, 250},
+	{PC_PREDICT, 0},
+	{PC_FAST_DELAY, 20}, /* ms */
+	{PC_MIN_IDLE, 100}, /* ms */
+	{SESSION_RECOVERY, 0},
+	{FW_DUMP_MAX_SIZE, 32}, /* MB */
+	{FW_DUMP_INTERVAL, 60}, /* s */
+	{THERMAL_MITIGATION, 1},
+	{NRT_THROUGHPUT_MODE, 0},
+	{NRT_SCHED_QUANTUM, 0}, /* ms, 0 disables */
+	{RT_LOAD_SHEDDING, 1},
+	{LLCC_MIN_DDR_SAVING, 400000}, /* kBps */
 	{STATS_TIMEOUT_MS, 2000},
 	{AV_SYNC_WINDOW_SIZE, 40},
 	{NON_FATAL_FAULTS, 1},
@@ -1397,6 +1418,22 @@ static struct msm_platform_inst_capability instance_cap_data_anorak[] = {
 	{BITSTREAM_SIZE_OVERWRITE, DEC, CODECS_ALL, 0, INT_MAX, 1, 0,
 		V4L2_CID_MPEG_VIDC_MIN_BITSTREAM_SIZE_OVERWRITE},
 
+	{ADAPTIVE_BITSTREAM_SIZE, ENC|DEC, CODECS_ALL,
+		V4L2_MPEG_MSM_VIDC_DISABLE, V4L2_MPEG_MSM_VIDC_ENABLE,
+		1, V4L2_MPEG_MSM_VIDC_DISABLE,
+		V4L2_CID_MPEG_VIDC_ADAPTIVE_BITSTREAM_SIZE},
+
+	{DECODE_BATCH_LATENCY, DEC, H264|HEVC|VP9|AV1,
+		0, 1000, 1, 0,
+		V4L2_CID_MPEG_VIDC_DECODE_BATCH_LATENCY,
+		0,
+		CAP_FLAG_DYNAMIC_ALLOWED},
+
+	{ENC_AUTO_BATCH, ENC, H264|HEVC,
+		V4L2_MPEG_MSM_VIDC_DISABLE, V4L2_MPEG_MSM_VIDC_ENABLE,
+		1, V4L2_MPEG_MSM_VIDC_DISABLE,
+		V4L2_CID_MPEG_VIDC_ENC_AUTO_BATCH},
+
 	{THUMBNAIL_MODE, DEC, CODECS_ALL,
 		V4L2_MPEG_MSM_VIDC_DISABLE, V4L2_MPEG_MSM_VIDC_ENABLE,
 		1, V4L2_MPEG_MSM_VIDC_DISABLE,
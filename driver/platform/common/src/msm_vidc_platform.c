@@ -103,6 +103,7 @@ static struct v4l2_ioctl_ops msm_v4l2_ioctl_ops_enc = {
 	.vidioc_unsubscribe_event       = msm_v4l2_unsubscribe_event,
 	.vidioc_try_encoder_cmd         = msm_v4l2_try_encoder_cmd,
 	.vidioc_encoder_cmd             = msm_v4l2_encoder_cmd,
+	.vidioc_default                 = msm_v4l2_default,
 };
 
 static struct v4l2_ioctl_ops msm_v4l2_ioctl_ops_dec = {
@@ -145,6 +146,7 @@ static struct v4l2_ioctl_ops msm_v4l2_ioctl_ops_dec = {
 	.vidioc_unsubscribe_event       = msm_v4l2_unsubscribe_event,
 	.vidioc_try_decoder_cmd         = msm_v4l2_try_decoder_cmd,
 	.vidioc_decoder_cmd             = msm_v4l2_decoder_cmd,
+	.vidioc_default                 = msm_v4l2_default,
 };
 
 static struct v4l2_ctrl_ops msm_v4l2_ctrl_ops = {
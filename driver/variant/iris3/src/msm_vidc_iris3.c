@@ -241,14 +241,17 @@ static int __prepare_enable_clock_iris3(struct msm_vidc_core *core,
 		 * it to the lowest frequency possible
 		 */
 		if (cl->has_scaling) {
-			rate = clk_round_rate(cl->clk, 0);
-			/**
-			 * source clock is already multipled with scaling ratio and __set_clk_rate
-			 * attempts to multiply again. So divide scaling ratio before calling
-			 * __set_clk_rate.
-			 */
-			rate = rate / MSM_VIDC_CLOCK_SOURCE_SCALING_RATIO;
-			__set_clk_rate(core, cl, rate);
+			/* lowest rate does not change, look it up only once */
+			if (!cl->min_rate) {
+				rate = clk_round_rate(cl->clk, 0);
+				/**
+				 * source clock is already multipled with scaling ratio and
+				 * __set_clk_rate attempts to multiply again. So divide scaling
+				 * ratio before calling __set_clk_rate.
+				 */
+				cl->min_rate = rate / MSM_VIDC_CLOCK_SOURCE_SCALING_RATIO;
+			}
+			__set_clk_rate(core, cl, cl->min_rate);
 		}
 
 		rc = clk_prepare_enable(cl->clk);
@@ -743,28 +746,34 @@ fail_regulator:
 static int __power_on_iris3(struct msm_vidc_core *core)
 {
 	int rc = 0;
+	u64 start_ns, step_ns;
 
 	if (core->power_enabled)
 		return 0;
 
 	/* Vote for all hardware resources */
+	start_ns = ktime_get_ns();
 	rc = __vote_buses(core, INT_MAX, INT_MAX);
 	if (rc) {
 		d_vpr_e("%s: failed to vote buses, rc %d\n", __func__, rc);
 		goto fail_vote_buses;
 	}
+	step_ns = __trace_power_step(core, "iris3_vote_buses", start_ns);
 
 	rc = __power_on_iris3_controller(core);
 	if (rc) {
 		d_vpr_e("%s: failed to power on iris3 controller\n", __func__);
 		goto fail_power_on_controller;
 	}
+	step_ns = __trace_power_step(core, "iris3_controller", step_ns);
 
 	rc = __power_on_iris3_hardware(core);
 	if (rc) {
 		d_vpr_e("%s: failed to power on iris3 hardware\n", __func__);
 		goto fail_power_on_hardware;
 	}
+	step_ns = __trace_power_step(core, "iris3_hardware", step_ns);
+
 	/* video controller and hardware powered on successfully */
 	core->power_enabled = true;
 
@@ -782,6 +791,7 @@ static int __power_on_iris3(struct msm_vidc_core *core)
 	call_venus_op(core, interrupt_init, core);
 	core->intr_status = 0;
 	enable_irq(core->dt->irq);
+	__trace_power_step(core, "iris3_registers", step_ns);
 
 	return rc;
 
@@ -17,6 +17,10 @@
 #define DCVS_ENC_EXTRA_INPUT_BUFFERS 4
 #define DCVS_DEC_EXTRA_OUTPUT_BUFFERS 4
 
+#define ADAPTIVE_BITSTREAM_MIN_SAMPLES 32
+#define ADAPTIVE_BITSTREAM_HEADROOM 2
+#define ADAPTIVE_BITSTREAM_MIN_SIZE SZ_64K
+
 u32 msm_vidc_input_min_count(struct msm_vidc_inst *inst);
 u32 msm_vidc_output_min_count(struct msm_vidc_inst *inst);
 u32 msm_vidc_input_extra_count(struct msm_vidc_inst *inst);
@@ -33,5 +37,12 @@ u32 msm_vidc_encoder_input_meta_size(struct msm_vidc_inst *inst);
 u32 msm_vidc_encoder_output_meta_size(struct msm_vidc_inst *inst);
 u32 msm_vidc_enc_delivery_mode_based_output_buf_size(struct msm_vidc_inst *inst,
 	u32 frame_size);
+bool msm_vidc_is_adaptive_bitstream_size(struct msm_vidc_inst *inst);
+u32 msm_vidc_get_bitstream_size(struct msm_vidc_inst *inst, u32 size);
+void msm_vidc_reset_bitstream_size(struct msm_vidc_inst *inst);
+bool msm_vidc_is_bitstream_shrunk(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf);
+int msm_vidc_update_bitstream_size(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, bool overflow);
 
 #endif // __H_MSM_VIDC_BUFFER_H__
@@ -65,6 +65,8 @@ enum msm_vidc_core_state {
 };
 
 struct msm_vidc_core {
+	struct list_head                       list; /* entry in msm_vidc_cores */
+	u32                                    id;
 	struct platform_device                *pdev;
 	struct msm_video_device                vdev[2];
 	struct v4l2_device                     v4l2_dev;
@@ -86,16 +88,36 @@ struct msm_vidc_core {
 	u32                                    codecs_count;
 	struct msm_vidc_core_capability       *capabilities;
 	struct msm_vidc_inst_capability       *inst_caps;
+	struct msm_vidc_inst_cap_dependency   *inst_cap_dependency;
+	enum msm_vidc_inst_capability_type    *inst_cap_order;
+	struct msm_vidc_cap_v4l2_map          *inst_cap_v4l2_map;
 	struct msm_vidc_mem_addr               sfr;
 	struct msm_vidc_mem_addr               iface_q_table;
 	struct msm_vidc_iface_q_info           iface_queues[VIDC_IFACEQ_NUMQ];
 	struct delayed_work                    pm_work;
 	struct workqueue_struct               *pm_workq;
 	struct workqueue_struct               *batch_workq;
+	struct workqueue_struct               *inst_workq; /* shared by all instances */
+	struct delayed_work                    stats_work;
 	struct delayed_work                    fw_unload_work;
+	struct work_struct                     fw_preload_work;
+	struct msm_vidc_fw_warm                fw_warm;
+	struct msm_vidc_fw_dump                fw_dump;
+	struct msm_vidc_thermal                thermal;
+	struct msm_vidc_nrt_sched              nrt_sched;
+	struct msm_vidc_load_shed              load_shed;
+	struct msm_vidc_sys_cache_policy       sys_cache;
 	struct work_struct                     ssr_work;
+	struct work_struct                     recovery_work;
 	struct msm_vidc_core_power             power;
 	struct msm_vidc_ssr                    ssr;
+	struct msm_vidc_cmdq_backlog           cmdq_backlog;
+	struct msm_vidc_irq_stats              irq_stats;
+	struct msm_vidc_pc_predictor           pc_predictor;
+	struct cpumask                         irq_cpus;
+	enum msm_vidc_irq_sched                irq_sched;
+	bool                                   irq_sched_update;
+	u64                                    irq_ts; /* last hard irq, ns */
 	bool                                   smmu_fault_handled;
 	u32                                    skip_pc_count;
 	u32                                    last_packet_type;
@@ -123,4 +145,8 @@ struct msm_vidc_core {
 	bool                                   video_unresponsive;
 };
 
+/* all probed cores, protected by msm_vidc_cores_lock */
+extern struct list_head msm_vidc_cores;
+extern struct mutex msm_vidc_cores_lock;
+
 #endif // _MSM_VIDC_CORE_H_
@@ -12,6 +12,7 @@
 #include <linux/types.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
+#include <linux/cpumask.h>
 
 #ifndef VIDC_DBG_LABEL
 #define VIDC_DBG_LABEL "msm_vidc"
@@ -38,6 +39,9 @@ extern int msm_vidc_ddr_bw;
 extern int msm_vidc_llc_bw;
 extern bool msm_vidc_fw_dump;
 extern unsigned int msm_vidc_enable_bugon;
+extern struct cpumask msm_vidc_irq_cpus;
+extern unsigned int msm_vidc_irq_sched;
+extern bool msm_vidc_workq_highpri;
 
 /* do not modify the log message as it is used in test scripts */
 #define FMT_STRING_SET_CTRL \
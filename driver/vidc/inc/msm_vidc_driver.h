@@ -298,6 +298,17 @@ static inline bool is_realtime_session(struct msm_vidc_inst *inst)
 	return inst->capabilities->cap[PRIORITY].value == 0 ? true : false;
 }
 
+/*
+ * non-realtime video sessions which run as fast as the hardware allows
+ * on whatever capacity realtime sessions leave over
+ */
+static inline bool is_throughput_session(struct msm_vidc_inst *inst)
+{
+	return !is_realtime_session(inst) && !is_thumbnail_session(inst) &&
+		!is_image_session(inst) &&
+		!!inst->core->capabilities[NRT_THROUGHPUT_MODE].value;
+}
+
 static inline bool is_critical_priority_session(struct msm_vidc_inst *inst)
 {
 	return !!(inst->capabilities->cap[CRITICAL_PRIORITY].value);
@@ -456,13 +467,27 @@ int msm_vidc_smmu_fault_handler(struct iommu_domain *domain,
 int msm_vidc_trigger_ssr(struct msm_vidc_core *core,
 		u64 trigger_ssr_val);
 void msm_vidc_ssr_handler(struct work_struct *work);
+int msm_vidc_core_recover(struct msm_vidc_core *core);
+void msm_vidc_recovery_handler(struct work_struct *work);
+int msm_vidc_session_streamon_prepare(struct msm_vidc_inst *inst);
 int msm_vidc_trigger_stability(struct msm_vidc_core *core,
 		u64 trigger_stability_val);
 void msm_vidc_stability_handler(struct work_struct *work);
 int cancel_stability_work_sync(struct msm_vidc_inst *inst);
+void msm_vidc_cmdq_error_handler(struct work_struct *work);
+int msm_vidc_update_cmdq_class(struct msm_vidc_inst *inst);
 void msm_vidc_fw_unload_handler(struct work_struct *work);
+void msm_vidc_fw_preload_handler(struct work_struct *work);
+bool msm_vidc_fw_warm_open(struct msm_vidc_core *core);
+void msm_vidc_fw_warm_ready(struct msm_vidc_core *core, u64 start_ns, bool cold);
 int msm_vidc_suspend(struct msm_vidc_core *core);
 void msm_vidc_batch_handler(struct work_struct *work);
+void msm_vidc_nrt_sched_kick(struct msm_vidc_core *core);
+void msm_vidc_nrt_sched_handler(struct work_struct *work);
+void msm_vidc_encode_batch_handler(struct work_struct *work);
+int msm_vidc_flush_encode_batch(struct msm_vidc_inst *inst);
+void msm_vidc_qbuf_batch_begin(struct msm_vidc_inst *inst);
+int msm_vidc_qbuf_batch_end(struct msm_vidc_inst *inst);
 int msm_vidc_event_queue_init(struct msm_vidc_inst *inst);
 int msm_vidc_event_queue_deinit(struct msm_vidc_inst *inst);
 int msm_vidc_vb2_queue_init(struct msm_vidc_inst *inst);
@@ -493,7 +518,6 @@ void msm_vidc_update_stats(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf, enum msm_vidc_debugfs_event etype);
 void msm_vidc_stats_handler(struct work_struct *work);
 int schedule_stats_work(struct msm_vidc_inst *inst);
-int cancel_stats_work_sync(struct msm_vidc_inst *inst);
 void msm_vidc_print_stats(struct msm_vidc_inst *inst);
 enum msm_vidc_buffer_type v4l2_type_to_driver(u32 type,
 	const char *func);
@@ -512,9 +536,20 @@ struct msm_vidc_buffer *get_meta_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *vbuf);
 struct msm_vidc_inst *get_inst_ref(struct msm_vidc_core *core,
 		struct msm_vidc_inst *instance);
+struct msm_vidc_inst *get_inst_ref_self(struct msm_vidc_inst *instance);
+struct msm_vidc_inst *get_inst_ref_any(struct msm_vidc_inst *instance);
 struct msm_vidc_inst *get_inst(struct msm_vidc_core *core,
 		u32 session_id);
 void put_inst(struct msm_vidc_inst *inst);
+int msm_vidc_alloc_core_id(struct msm_vidc_core *core);
+void msm_vidc_free_core_id(struct msm_vidc_core *core);
+void msm_vidc_register_core(struct msm_vidc_core *core);
+void msm_vidc_unregister_core(struct msm_vidc_core *core);
+struct workqueue_struct *msm_vidc_create_workqueue(const char *name);
+int msm_vidc_set_irq_affinity(struct msm_vidc_core *core,
+	const struct cpumask *mask);
+int msm_vidc_set_irq_sched(struct msm_vidc_core *core, u32 sched);
+u64 msm_vidc_get_core_load(struct msm_vidc_core *core, u32 *count);
 bool msm_vidc_allow_s_fmt(struct msm_vidc_inst *inst, u32 type);
 bool msm_vidc_allow_s_ctrl(struct msm_vidc_inst *inst, u32 id);
 bool msm_vidc_allow_metadata_delivery(struct msm_vidc_inst *inst,
@@ -550,6 +585,12 @@ int msm_vidc_process_psc_last_flag(struct msm_vidc_inst *inst);
 int msm_vidc_get_mbs_per_frame(struct msm_vidc_inst *inst);
 u32 msm_vidc_get_max_bitrate(struct msm_vidc_inst* inst);
 int msm_vidc_get_fps(struct msm_vidc_inst *inst);
+u32 msm_vidc_get_grid_tile_count(struct msm_vidc_inst *inst);
+void msm_vidc_image_stats_etb(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf);
+void msm_vidc_image_stats_fbd(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf);
+void msm_vidc_image_stats_reset(struct msm_vidc_inst *inst);
 int msm_vidc_num_buffers(struct msm_vidc_inst *inst,
 	enum msm_vidc_buffer_type type, enum msm_vidc_buffer_attributes attr);
 void core_lock(struct msm_vidc_core *core, const char *function);
@@ -573,6 +614,7 @@ int msm_vidc_deinit_instance_caps(struct msm_vidc_core* core);
 int msm_vidc_update_debug_str(struct msm_vidc_inst *inst);
 void msm_vidc_allow_dcvs(struct msm_vidc_inst *inst);
 bool msm_vidc_allow_decode_batch(struct msm_vidc_inst *inst);
+bool msm_vidc_allow_encode_batch(struct msm_vidc_inst *inst);
 int msm_vidc_check_session_supported(struct msm_vidc_inst *inst);
 bool msm_vidc_ignore_session_load(struct msm_vidc_inst *inst);
 int msm_vidc_check_core_mbps(struct msm_vidc_inst *inst);
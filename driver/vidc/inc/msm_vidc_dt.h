@@ -135,6 +135,7 @@ struct clock_info {
 	bool has_scaling;
 	bool has_mem_retention;
 	u64 prev;
+	u64 min_rate; /* lowest rate, cached on first enable */
 	struct mmrm_client *mmrm_client;
 };
 
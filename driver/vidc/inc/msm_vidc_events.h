@@ -292,6 +292,110 @@ DEFINE_EVENT(msm_vidc_buffer_dma_ops, msm_vidc_dma_buffer,
 	TP_ARGS(buffer_op, dmabuf, size, kvaddr, buf_name, secure, region)
 );
 
+DECLARE_EVENT_CLASS(msm_vidc_latency,
+
+	TP_PROTO(const char *name, u32 core_id, u64 latency_us),
+
+	TP_ARGS(name, core_id, latency_us),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, core_id)
+		__field(u64, latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->core_id = core_id;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("%s: core%u latency %llu us\n",
+		__entry->name, __entry->core_id, __entry->latency_us)
+);
+
+DEFINE_EVENT(msm_vidc_latency, msm_vidc_irq_latency,
+
+	TP_PROTO(const char *name, u32 core_id, u64 latency_us),
+
+	TP_ARGS(name, core_id, latency_us)
+);
+
+DEFINE_EVENT(msm_vidc_latency, msm_vidc_fbd_latency,
+
+	TP_PROTO(const char *name, u32 core_id, u64 latency_us),
+
+	TP_ARGS(name, core_id, latency_us)
+);
+
+DEFINE_EVENT(msm_vidc_latency, msm_vidc_power_step,
+
+	TP_PROTO(const char *name, u32 core_id, u64 latency_us),
+
+	TP_ARGS(name, core_id, latency_us)
+);
+
+TRACE_EVENT(msm_vidc_thermal_throttle,
+
+	TP_PROTO(u32 core_id, u32 state, const char *action, u64 requested, u64 granted),
+
+	TP_ARGS(core_id, state, action, requested, granted),
+
+	TP_STRUCT__entry(
+		__field(u32, core_id)
+		__field(u32, state)
+		__field(const char *, action)
+		__field(u64, requested)
+		__field(u64, granted)
+	),
+
+	TP_fast_assign(
+		__entry->core_id = core_id;
+		__entry->state = state;
+		__entry->action = action;
+		__entry->requested = requested;
+		__entry->granted = granted;
+	),
+
+	TP_printk("core%u: thermal state %u %s, requested %llu granted %llu\n",
+		__entry->core_id, __entry->state, __entry->action,
+		__entry->requested, __entry->granted)
+);
+
+TRACE_EVENT(msm_vidc_load_shed,
+
+	TP_PROTO(u32 core_id, u32 session_id, const char *action, u64 demand, u64 capacity),
+
+	TP_ARGS(core_id, session_id, action, demand, capacity),
+
+	TP_STRUCT__entry(
+		__field(u32, core_id)
+		__field(u32, session_id)
+		__field(const char *, action)
+		__field(u64, demand)
+		__field(u64, capacity)
+	),
+
+	TP_fast_assign(
+		__entry->core_id = core_id;
+		__entry->session_id = session_id;
+		__entry->action = action;
+		__entry->demand = demand;
+		__entry->capacity = capacity;
+	),
+
+	TP_printk("core%u: session %#x %s, rt demand %llu capacity %llu\n",
+		__entry->core_id, __entry->session_id, __entry->action,
+		__entry->demand, __entry->capacity)
+);
+
+DEFINE_EVENT(msm_vidc_latency, msm_vidc_open_latency,
+
+	TP_PROTO(const char *name, u32 core_id, u64 latency_us),
+
+	TP_ARGS(name, core_id, latency_us)
+);
+
 #endif
 
 /* This part must be outside protection */
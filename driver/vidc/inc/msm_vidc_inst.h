@@ -149,16 +149,21 @@ struct msm_vidc_inst {
 	struct msm_vidc_subscription_params       subcr_params[MAX_PORT];
 	struct msm_vidc_hfi_frame_info     hfi_frame_info;
 	struct msm_vidc_decode_batch       decode_batch;
+	struct msm_vidc_encode_batch       encode_batch;
+	struct msm_vidc_image_stats        image_stats;
+	struct msm_vidc_qbuf_batch         qbuf_batch;
+	struct msm_vidc_bitstream_size     bitstream_size;
+	struct msm_vidc_throughput         throughput;
+	struct msm_vidc_nrt_slice          nrt_slice;
+	struct msm_vidc_shed               shed;
 	struct msm_vidc_decode_vpp_delay   decode_vpp_delay;
 	struct msm_vidc_session_idle       session_idle;
-	struct delayed_work                stats_work;
 	struct work_struct                 stability_work;
+	struct work_struct                 cmdq_error_work;
 	struct msm_vidc_stability          stability;
-	struct workqueue_struct           *workq;
 	struct list_head                   enc_input_crs;
 	struct list_head                   dmabuf_tracker; /* list of struct msm_memory_dmabuf */
 	struct list_head                   input_timer_list; /* list of struct msm_vidc_input_timer */
-	struct list_head                   caps_list;
 	struct list_head                   children_list; /* struct msm_vidc_inst_cap_entry */
 	struct list_head                   firmware_list; /* struct msm_vidc_inst_cap_entry */
 	struct list_head                   pending_pkts; /* list of struct hfi_pending_packet */
@@ -167,6 +172,9 @@ struct msm_vidc_inst {
 	bool                               once_per_session_set;
 	bool                               ipsc_properties_set;
 	bool                               opsc_properties_set;
+	bool                               recovery_pending; /* survives fw restart */
+	bool                               cmdq_realtime; /* under core lock */
+	u32                                recovery_count;
 	struct dentry                     *debugfs_root;
 	struct msm_vidc_debug              debug;
 	struct debug_buf_count             debug_count;
@@ -329,6 +329,9 @@ enum msm_vidc_core_capability_type {
 	SW_PC_DELAY,
 	FW_UNLOAD,
 	FW_UNLOAD_DELAY,
+	FW_PRELOAD,
+	FW_KEEP_WARM,
+	FW_KEEP_WARM_MAX,
 	HW_RESPONSE_TIMEOUT,
 	PREFIX_BUF_COUNT_PIX,
 	PREFIX_BUF_SIZE_PIX,
@@ -339,6 +342,24 @@ enum msm_vidc_core_capability_type {
 	DCVS,
 	DECODE_BATCH,
 	DECODE_BATCH_TIMEOUT,
+	ENCODE_BATCH_FPS,
+	ENCODE_BATCH_TIMEOUT,
+	CMDQ_BACKLOG_SIZE,
+	CMDQ_BACKLOG_TIMEOUT,
+	IRQ_POLL_MSG_RATE,
+	IRQ_POLL_BUDGET,
+	IRQ_POLL_INTERVAL_US,
+	PC_PREDICT,
+	PC_FAST_DELAY,
+	PC_MIN_IDLE,
+	SESSION_RECOVERY,
+	FW_DUMP_MAX_SIZE,
+	FW_DUMP_INTERVAL,
+	THERMAL_MITIGATION,
+	NRT_THROUGHPUT_MODE,
+	NRT_SCHED_QUANTUM,
+	RT_LOAD_SHEDDING,
+	LLCC_MIN_DDR_SAVING,
 	STATS_TIMEOUT_MS,
 	AV_SYNC_WINDOW_SIZE,
 	CLK_FREQ_THRESHOLD,
@@ -349,14 +370,14 @@ enum msm_vidc_core_capability_type {
 };
 
 /**
- * msm_vidc_prepare_dependency_list() api will prepare caps_list by looping over
- * enums(msm_vidc_inst_capability_type) from 0 to INST_CAP_MAX and arranges the
- * node in such a way that parents willbe at the front and dependent children
- * in the back.
+ * msm_vidc_prepare_dependency_list() api will prepare dependency order by looping
+ * over enums(msm_vidc_inst_capability_type) from 0 to INST_CAP_MAX and arranges
+ * the node in such a way that parents willbe at the front and dependent children
+ * in the back. It runs once per codec at core init.
  *
- * caps_list preparation may become CPU intensive task, so to save CPU cycles,
- * organize enum in proper order(root caps at the beginning and dependent caps
- * at back), so that during caps_list preparation num CPU cycles spent will reduce.
+ * Dependency order preparation may become CPU intensive task, so to save CPU
+ * cycles, organize enum in proper order(root caps at the beginning and dependent
+ * caps at back), so that during preparation num CPU cycles spent will reduce.
  *
  * Note: It will work, if enum kept at different places, but not efficient.
  */
@@ -501,6 +522,9 @@ enum msm_vidc_inst_capability_type {
 	LOWLATENCY_MAX_BITRATE,
 	LAST_FLAG_EVENT_ENABLE,
 	NUM_COMV,
+	ADAPTIVE_BITSTREAM_SIZE,
+	DECODE_BATCH_LATENCY,
+	ENC_AUTO_BATCH,
 	/* place all root(no parent) enums before this line */
 
 	PROFILE,
@@ -565,6 +589,10 @@ struct msm_vidc_inst_cap {
 	u32 v4l2_id;
 	u32 hfi_id;
 	enum msm_vidc_inst_capability_flags flags;
+};
+
+/* read only after core init, shared by all instances of a codec */
+struct msm_vidc_inst_cap_dependency {
 	enum msm_vidc_inst_capability_type parents[MAX_CAP_PARENTS];
 	enum msm_vidc_inst_capability_type children[MAX_CAP_CHILDREN];
 	int (*adjust)(void *inst,
@@ -573,9 +601,20 @@ struct msm_vidc_inst_cap {
 		enum msm_vidc_inst_capability_type cap_id);
 };
 
+/* v4l2_id to cap_id index entry, sorted by v4l2_id per codec */
+struct msm_vidc_cap_v4l2_map {
+	u32 v4l2_id;
+	enum msm_vidc_inst_capability_type cap_id;
+};
+
 struct msm_vidc_inst_capability {
 	enum msm_vidc_domain_type domain;
 	enum msm_vidc_codec_type codec;
+	const struct msm_vidc_inst_cap_dependency *dependency;
+	const enum msm_vidc_inst_capability_type *dependency_order;
+	u32 dependency_order_count;
+	const struct msm_vidc_cap_v4l2_map *v4l2_map;
+	u32 v4l2_map_count;
 	struct msm_vidc_inst_cap cap[INST_CAP_MAX+1];
 };
 
@@ -613,6 +652,14 @@ enum sku_version {
 	SKU_VERSION_2,
 };
 
+enum msm_vidc_irq_sched {
+	MSM_VIDC_IRQ_SCHED_DEFAULT = 0,
+	MSM_VIDC_IRQ_SCHED_NORMAL,
+	MSM_VIDC_IRQ_SCHED_FIFO_LOW,
+	MSM_VIDC_IRQ_SCHED_FIFO,
+	MSM_VIDC_IRQ_SCHED_MAX,
+};
+
 enum msm_vidc_ssr_trigger_type {
 	SSR_ERR_FATAL = 1,
 	SSR_SW_DIV_BY_ZERO,
@@ -796,6 +843,102 @@ struct msm_vidc_decode_batch {
 	bool                   enable;
 	u32                    size;
 	struct delayed_work    work;
+	u32                    cur_size;
+	u32                    timeout_ms;
+	u32                    avg_interval_us;
+	u64                    last_qbuf_us;
+	u32                    flush_count;
+	u32                    timeout_count;
+};
+
+struct msm_vidc_encode_batch {
+	bool                   enable;
+	bool                   hold_intr;
+	u32                    size;
+	u32                    cur_size;
+	u32                    timeout_ms;
+	struct delayed_work    work;
+	u32                    frame_size;
+	u32                    meta_size;
+	u32                    flush_count;
+	u32                    timeout_count;
+};
+
+#define MAX_PENDING_IMAGES 8
+
+struct msm_vidc_image_pending {
+	u64                    timestamp;
+	u64                    start_us;
+};
+
+struct msm_vidc_image_stats {
+	struct msm_vidc_image_pending pending[MAX_PENDING_IMAGES];
+	u32                    head;
+	u32                    count;
+	u32                    tiles;
+	u32                    num_images;
+	u64                    last_latency_us;
+	u64                    max_latency_us;
+	u64                    total_latency_us;
+};
+
+/* achieved frame rate, measured over one second windows of EBDs */
+struct msm_vidc_throughput {
+	u64                    window_start_ns;
+	u32                    window_frames;
+	u32                    fps;
+	u32                    peak_fps;
+};
+
+/*
+ * per session share of the core when offline sessions oversubscribe it.
+ * vruntime advances by run time divided by weight, the lowest runs next.
+ */
+struct msm_vidc_nrt_slice {
+	bool                   paused; /* under inst lock */
+	bool                   selected;
+	u32                    weight;
+	u64                    vruntime_ns;
+	u64                    run_ns;
+	u64                    start_ns;
+	u32                    slices;
+	u32                    preempts;
+};
+
+struct msm_vidc_nrt_sched {
+	struct delayed_work                work;
+	u32                                rounds;
+	u32                                sliced_rounds;
+	u32                                waiting;
+};
+
+/* whether the session mix is worth holding llcc slices for */
+struct msm_vidc_sys_cache_policy {
+	bool                   enable;
+	u64                    ddr_saved;
+	u32                    activations;
+	u32                    releases;
+};
+
+/* realtime clock demand against what the clock table can deliver */
+struct msm_vidc_load_shed {
+	u64                    demand;
+	u64                    capacity;
+	u32                    overload_count;
+};
+
+/* target is chosen under core lock, level is applied under inst lock */
+struct msm_vidc_shed {
+	u32                    target;
+	u32                    level;
+	u32                    count;
+};
+
+struct msm_vidc_bitstream_size {
+	u32                    max_filled;
+	u32                    samples;
+	u32                    recommended;
+	u32                    fallback_count;
 };
 
 enum msm_vidc_power_mode {
@@ -839,6 +982,7 @@ struct msm_vidc_power {
 	u64                    curr_freq;
 	u32                    ddr_bw;
 	u32                    sys_cache_bw;
+	u32                    ddr_saved; /* estimated, with llcc slices set */
 	u32                    dcvs_flags;
 	u32                    fw_cr;
 	u32                    fw_cf;
@@ -975,6 +1119,96 @@ struct msm_vidc_ssr {
 	u32                                test_addr;
 };
 
+struct msm_vidc_qbuf_batch {
+	struct task_struct                *owner; /* holds inst locks */
+	bool                               scale;
+	bool                               scale_buses;
+	u32                                held; /* cmdq writes without doorbell */
+	u64                                calls;
+	u64                                buffers;
+};
+
+struct msm_vidc_cmdq_backlog {
+	struct list_head                   list; /* fifo per session, RT ahead of NRT */
+	struct delayed_work                work;
+	u32                                count;
+	u32                                count_hwm;
+	u32                                occupancy_hwm; /* percent */
+	u32                                deferred_count;
+	u32                                drop_count;
+};
+
+/*
+ * Cooling states: 1..THERMAL_NRT_LEVELS scale down the clock vote of
+ * non-realtime sessions, higher states cap the core clock one allowed
+ * rate at a time, which then affects realtime sessions as well.
+ */
+#define THERMAL_NRT_LEVELS 3
+
+struct msm_vidc_thermal {
+	struct thermal_cooling_device     *cdev;
+	unsigned long                      state;
+	unsigned long                      max_state;
+	u32                                throttle_count;
+};
+
+struct msm_vidc_fw_dump {
+	struct work_struct                 work;
+	void                              *mem_va; /* fw region, mapped until copied */
+	size_t                             mem_size;
+	u64                                last_ns;
+	u32                                count;
+	u32                                skip_count; /* rate limited */
+};
+
+enum msm_vidc_fw_keep_warm {
+	MSM_VIDC_FW_WARM_DELAY             = 0, /* unload after FW_UNLOAD_DELAY */
+	MSM_VIDC_FW_WARM_USAGE             = 1, /* stretch delay with reuse */
+	MSM_VIDC_FW_WARM_PREDICT           = 2, /* cover observed close-to-open gap */
+};
+
+struct msm_vidc_fw_warm {
+	u64                                last_close_ns;
+	u32                                idle_avg_ms; /* ewma of close-to-open gaps */
+	u32                                open_count; /* since last load */
+	u32                                warm_opens;
+	u32                                cold_opens;
+	u32                                preloads;
+	u32                                unloads;
+	u32                                ready_us; /* last open-to-ready latency */
+};
+
+/* collapsed residency buckets: <10, <50, <100, <500, <1000, >=1000 ms */
+#define PC_RESIDENCY_BINS 6
+
+struct msm_vidc_pc_predictor {
+	u32                                gap_us; /* predicted idle gap */
+	u32                                idle_avg_us; /* ewma of observed gaps */
+	u64                                idle_start_ns; /* last fw response */
+	u32                                resume_cost_us; /* ewma */
+	u32                                backoff;
+	bool                               fast_pending;
+	u64                                collapse_ns;
+	u32                                collapse_count;
+	u32                                fast_count;
+	u32                                resume_count;
+	u32                                mispredict_short; /* resumed before break-even */
+	u32                                mispredict_busy; /* fast collapse refused by fw */
+	u32                                residency[PC_RESIDENCY_BINS];
+};
+
+struct msm_vidc_irq_stats {
+	u64                                window_start;
+	u32                                window_irqs;
+	u32                                window_msgs;
+	u32                                irq_rate; /* per second */
+	u32                                msg_rate; /* per second */
+	u32                                msgs_per_irq; /* x100 */
+	u64                                total_irqs;
+	u64                                total_msgs;
+	u64                                poll_count;
+};
+
 struct msm_vidc_stability {
 	enum msm_vidc_stability_trigger_type     stability_type;
 	u32                                      sub_client_id;
@@ -254,4 +254,6 @@ int msm_vidc_get_inst_load(struct msm_vidc_inst *inst);
 int msm_vidc_get_mbps(struct msm_vidc_inst *inst);
 int msm_vidc_scale_power(struct msm_vidc_inst *inst, bool scale_buses);
 void msm_vidc_power_data_reset(struct msm_vidc_inst *inst);
+int msm_vidc_thermal_init(struct msm_vidc_core *core);
+void msm_vidc_thermal_deinit(struct msm_vidc_core *core);
 #endif
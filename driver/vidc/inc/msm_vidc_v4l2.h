@@ -44,6 +44,8 @@ int msm_v4l2_qbuf(struct file *file, void *fh,
 		struct v4l2_buffer *b);
 int msm_v4l2_dqbuf(struct file *file, void *fh,
 		struct v4l2_buffer *b);
+long msm_v4l2_default(struct file *file, void *fh,
+		bool valid_prio, unsigned int cmd, void *arg);
 int msm_v4l2_streamon(struct file *file, void *fh,
 		enum v4l2_buf_type i);
 int msm_v4l2_streamoff(struct file *file, void *fh,
@@ -39,6 +39,7 @@ int venus_hfi_session_property(struct msm_vidc_inst *inst,
 int venus_hfi_session_command(struct msm_vidc_inst *inst,
 	u32 cmd, enum msm_vidc_port_type port, u32 payload_type,
 	void *payload, u32 payload_size);
+int venus_hfi_raise_doorbell(struct msm_vidc_core *core);
 int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buffer, struct msm_vidc_buffer *metabuf);
 int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
@@ -66,10 +67,14 @@ int venus_hfi_trigger_stability(struct msm_vidc_inst *inst, u32 type,
 int venus_hfi_reserve_hardware(struct msm_vidc_inst *inst, u32 duration);
 int venus_hfi_scale_clocks(struct msm_vidc_inst* inst, u64 freq);
 int venus_hfi_scale_buses(struct msm_vidc_inst* inst, u64 bw_ddr, u64 bw_llcc);
+int venus_hfi_set_sys_cache(struct msm_vidc_inst *inst, bool enable);
 int venus_hfi_set_ir_period(struct msm_vidc_inst *inst, u32 ir_type,
 	enum msm_vidc_inst_capability_type cap_id);
 
+u64 __trace_power_step(struct msm_vidc_core *core, const char *step, u64 start_ns);
 void venus_hfi_pm_work_handler(struct work_struct *work);
+void venus_hfi_cmdq_backlog_handler(struct work_struct *work);
+void venus_hfi_cmdq_backlog_flush(struct msm_vidc_core *core);
 irqreturn_t venus_hfi_isr(int irq, void *data);
 irqreturn_t venus_hfi_isr_handler(int irq, void *data);
 int venus_hfi_interface_queues_init(struct msm_vidc_core *core);
@@ -17,6 +17,7 @@
 #include "msm_vidc_control.h"
 #include "msm_vidc_debug.h"
 #include "msm_vidc_power.h"
+#include "msm_vidc_buffer.h"
 #include "msm_vidc_control.h"
 #include "msm_vidc_memory.h"
 #include "venus_hfi.h"
@@ -24,6 +25,8 @@
 /* TODO: update based on clips */
 #define MAX_DEC_BATCH_SIZE 6
 #define SKIP_BATCH_WINDOW 100
+#define MIN_DEC_BATCH_SIZE 2
+#define BATCH_INTERVAL_MAX_US 1000000
 
 static const u32 msm_vdec_subscribe_for_psc_avc[] = {
 	HFI_PROP_BITSTREAM_RESOLUTION,
@@ -1533,7 +1536,7 @@ static int schedule_batch_work(struct msm_vidc_inst *inst)
 	}
 	core = inst->core;
 	mod_delayed_work(core->batch_workq, &inst->decode_batch.work,
-		msecs_to_jiffies(core->capabilities[DECODE_BATCH_TIMEOUT].value));
+		msecs_to_jiffies(inst->decode_batch.timeout_ms));
 
 	return 0;
 }
@@ -1855,12 +1858,59 @@ static inline enum msm_vidc_allow msm_vdec_allow_queue_deferred_buffers(
 
 	/* defer qbuf, if pending buffers count less than batch size */
 	count = msm_vidc_num_buffers(inst, MSM_VIDC_BUF_OUTPUT, MSM_VIDC_ATTR_DEFERRED);
-	if (count < inst->decode_batch.size)
+	if (count < inst->decode_batch.cur_size)
 		return MSM_VIDC_DEFER;
 
 	return MSM_VIDC_ALLOW;
 }
 
+/*
+ * Size the batch from the observed output qbuf cadence so that the first
+ * deferred buffer never waits longer than the session latency ceiling.
+ * Ceiling is the client DECODE_BATCH_LATENCY if set, else core timeout.
+ */
+static void msm_vdec_update_batch_params(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_decode_batch *batch;
+	u64 now_us, ceiling_us, timeout_us;
+	u32 interval_us, size;
+
+	batch = &inst->decode_batch;
+	now_us = div_u64(ktime_get_ns(), NSEC_PER_USEC);
+	if (batch->last_qbuf_us && now_us > batch->last_qbuf_us) {
+		interval_us = (u32)min_t(u64, now_us - batch->last_qbuf_us,
+			BATCH_INTERVAL_MAX_US);
+		/* ignore long gaps like pause/seek, keep running average */
+		if (interval_us < BATCH_INTERVAL_MAX_US)
+			batch->avg_interval_us = batch->avg_interval_us ?
+				(batch->avg_interval_us * 7 + interval_us) >> 3 :
+				interval_us;
+	}
+	batch->last_qbuf_us = now_us;
+
+	if (!batch->avg_interval_us)
+		return;
+
+	ceiling_us = inst->capabilities->cap[DECODE_BATCH_LATENCY].value ?
+		inst->capabilities->cap[DECODE_BATCH_LATENCY].value :
+		inst->core->capabilities[DECODE_BATCH_TIMEOUT].value;
+	ceiling_us *= 1000;
+
+	size = (u32)div_u64(ceiling_us, batch->avg_interval_us);
+	size = clamp_t(u32, size, MIN_DEC_BATCH_SIZE, batch->size);
+
+	timeout_us = (u64)batch->avg_interval_us * size +
+		(batch->avg_interval_us >> 1);
+	/* a sub-millisecond ceiling wins over the 1 ms floor */
+	timeout_us = clamp_t(u64, timeout_us, min_t(u64, 1000, ceiling_us), ceiling_us);
+
+	if (size != batch->cur_size)
+		i_vpr_l(inst, "%s: batch size %u -> %u, interval %u us\n",
+			__func__, batch->cur_size, size, batch->avg_interval_us);
+	batch->cur_size = size;
+	batch->timeout_ms = (u32)div_u64(timeout_us + 999, 1000);
+}
+
 static int msm_vdec_qbuf_batch(struct msm_vidc_inst *inst,
 	struct vb2_buffer *vb2)
 {
@@ -1888,17 +1938,22 @@ static int msm_vdec_qbuf_batch(struct msm_vidc_inst *inst,
 		return 0;
 	}
 
+	msm_vdec_update_batch_params(inst);
 	allow = msm_vdec_allow_queue_deferred_buffers(inst);
 	if (allow == MSM_VIDC_DISALLOW) {
 		i_vpr_e(inst, "%s: queue deferred buffers not allowed\n", __func__);
 		return -EINVAL;
 	} else if (allow == MSM_VIDC_DEFER) {
 		print_vidc_buffer(VIDC_LOW, "low ", "batch-qbuf deferred", inst, buf);
-		schedule_batch_work(inst);
+		/* arm once per batch so the first buffer's wait stays bounded */
+		if (msm_vidc_num_buffers(inst, MSM_VIDC_BUF_OUTPUT,
+				MSM_VIDC_ATTR_DEFERRED) == 1)
+			schedule_batch_work(inst);
 		return 0;
 	}
 
 	cancel_batch_work(inst);
+	inst->decode_batch.flush_count++;
 	rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_OUTPUT);
 	if (rc)
 		return rc;
@@ -2395,6 +2450,7 @@ int msm_vdec_s_fmt(struct msm_vidc_inst *inst, struct v4l2_format *f)
 		}
 		inst->buffers.input.size =
 			fmt->fmt.pix_mp.plane_fmt[0].sizeimage;
+		msm_vidc_reset_bitstream_size(inst);
 		/* update input port color info */
 		fmt->fmt.pix_mp.colorspace = f->fmt.pix_mp.colorspace;
 		fmt->fmt.pix_mp.xfer_func = f->fmt.pix_mp.xfer_func;
@@ -2531,6 +2587,9 @@ int msm_vdec_g_fmt(struct msm_vidc_inst *inst, struct v4l2_format *f)
 		return -EINVAL;
 
 	memcpy(f, &inst->fmts[port], sizeof(struct v4l2_format));
+	if (port == INPUT_PORT)
+		f->fmt.pix_mp.plane_fmt[0].sizeimage = msm_vidc_get_bitstream_size(inst,
+			f->fmt.pix_mp.plane_fmt[0].sizeimage);
 
 	return rc;
 }
@@ -2592,6 +2651,9 @@ int msm_vdec_subscribe_event(struct msm_vidc_inst *inst,
 
 	switch (sub->type) {
 	case V4L2_EVENT_EOS:
+	case V4L2_EVENT_VIDC_RECOVERED:
+	case V4L2_EVENT_VIDC_LOAD_SHED:
+	case V4L2_EVENT_VIDC_BITSTREAM_SIZE:
 		rc = v4l2_event_subscribe(&inst->event_handler, sub, MAX_EVENTS, NULL);
 		break;
 	case V4L2_EVENT_SOURCE_CHANGE:
@@ -2726,6 +2788,9 @@ int msm_vdec_inst_init(struct msm_vidc_inst *inst)
 	if (core->capabilities[DECODE_BATCH].value) {
 		inst->decode_batch.enable = true;
 		inst->decode_batch.size = MAX_DEC_BATCH_SIZE;
+		inst->decode_batch.cur_size = MAX_DEC_BATCH_SIZE;
+		inst->decode_batch.timeout_ms =
+			core->capabilities[DECODE_BATCH_TIMEOUT].value;
 	}
 	if (core->capabilities[DCVS].value)
 		inst->power.dcvs_mode = true;
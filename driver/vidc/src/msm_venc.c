@@ -15,9 +15,12 @@
 #include "msm_vidc_control.h"
 #include "msm_vidc_debug.h"
 #include "msm_vidc_power.h"
+#include "msm_vidc_buffer.h"
 #include "venus_hfi.h"
 #include "hfi_packet.h"
 
+#define MAX_ENC_BATCH_SIZE 8
+
 static const u32 msm_venc_input_set_prop[] = {
 	HFI_PROP_COLOR_FORMAT,
 	HFI_PROP_RAW_RESOLUTION,
@@ -798,6 +801,9 @@ int msm_venc_streamoff_input(struct msm_vidc_inst *inst)
 		return -EINVAL;
 	}
 
+	/* cancel pending batch work */
+	cancel_delayed_work(&inst->encode_batch.work);
+	msm_vidc_image_stats_reset(inst);
 	rc = msm_vidc_session_streamoff(inst, INPUT_PORT);
 	if (rc)
 		return rc;
@@ -836,6 +842,12 @@ int msm_venc_streamon_input(struct msm_vidc_inst *inst)
 	if (rc)
 		goto error;
 
+	/* input resolution is fixed while streaming, cache per frame sizes */
+	inst->encode_batch.frame_size = call_session_op(inst->core,
+		buffer_size, inst, MSM_VIDC_BUF_INPUT);
+	inst->encode_batch.meta_size = call_session_op(inst->core,
+		buffer_size, inst, MSM_VIDC_BUF_INPUT_META);
+
 	rc = msm_venc_set_input_properties(inst);
 	if (rc)
 		goto error;
@@ -875,6 +887,46 @@ error:
 	return rc;
 }
 
+static int msm_venc_qbuf_batch(struct msm_vidc_inst *inst,
+	struct vb2_buffer *vb2)
+{
+	struct msm_vidc_buffer *buf;
+	enum msm_vidc_allow allow;
+	int count;
+
+	if (!inst || !inst->core || !vb2) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	buf = msm_vidc_get_driver_buf(inst, vb2);
+	if (!buf)
+		return -EINVAL;
+
+	msm_vidc_add_buffer_stats(inst, buf);
+
+	allow = msm_vidc_allow_qbuf(inst, vb2->type);
+	if (allow == MSM_VIDC_DISALLOW) {
+		i_vpr_e(inst, "%s: qbuf not allowed\n", __func__);
+		return -EINVAL;
+	} else if (allow == MSM_VIDC_DEFER) {
+		print_vidc_buffer(VIDC_LOW, "low ", "qbuf deferred", inst, buf);
+		return 0;
+	}
+
+	/* hold input until batch is full or the latency window expires */
+	count = msm_vidc_num_buffers(inst, MSM_VIDC_BUF_INPUT, MSM_VIDC_ATTR_DEFERRED);
+	if (count < inst->encode_batch.cur_size) {
+		print_vidc_buffer(VIDC_LOW, "low ", "batch-qbuf deferred", inst, buf);
+		if (count == 1)
+			mod_delayed_work(inst->core->batch_workq, &inst->encode_batch.work,
+				msecs_to_jiffies(inst->encode_batch.timeout_ms));
+		return 0;
+	}
+
+	return msm_vidc_flush_encode_batch(inst);
+}
+
 int msm_venc_qbuf(struct msm_vidc_inst *inst, struct vb2_buffer *vb2)
 {
 	int rc = 0;
@@ -884,7 +936,11 @@ int msm_venc_qbuf(struct msm_vidc_inst *inst, struct vb2_buffer *vb2)
 		return -EINVAL;
 	}
 
-	rc = msm_vidc_queue_buffer_single(inst, vb2);
+	/* batch encoder input buffers only */
+	if (inst->encode_batch.enable && vb2->type == INPUT_MPLANE)
+		rc = msm_venc_qbuf_batch(inst, vb2);
+	else
+		rc = msm_vidc_queue_buffer_single(inst, vb2);
 	if (rc)
 		return rc;
 
@@ -910,6 +966,10 @@ int msm_venc_process_cmd(struct msm_vidc_inst *inst, u32 cmd)
 			return 0;
 		else if (allow != MSM_VIDC_ALLOW)
 			return -EINVAL;
+		/* held input must reach fw ahead of the drain */
+		rc = msm_vidc_flush_encode_batch(inst);
+		if (rc)
+			return rc;
 		rc = msm_vidc_process_drain(inst);
 		if (rc)
 			return rc;
@@ -1137,6 +1197,7 @@ int msm_venc_s_fmt_output(struct msm_vidc_inst *inst, struct v4l2_format *f)
 	}
 	inst->buffers.output.size =
 		fmt->fmt.pix_mp.plane_fmt[0].sizeimage;
+	msm_vidc_reset_bitstream_size(inst);
 
 	/* reset metadata buffer size with updated resolution*/
 	msm_vidc_update_meta_port_settings(inst);
@@ -1385,6 +1446,9 @@ int msm_venc_g_fmt(struct msm_vidc_inst *inst, struct v4l2_format *f)
 		return -EINVAL;
 
 	memcpy(f, &inst->fmts[port], sizeof(struct v4l2_format));
+	if (port == OUTPUT_PORT)
+		f->fmt.pix_mp.plane_fmt[0].sizeimage = msm_vidc_get_bitstream_size(inst,
+			f->fmt.pix_mp.plane_fmt[0].sizeimage);
 
 	return rc;
 }
@@ -1697,6 +1761,9 @@ int msm_venc_subscribe_event(struct msm_vidc_inst *inst,
 
 	switch (sub->type) {
 	case V4L2_EVENT_EOS:
+	case V4L2_EVENT_VIDC_RECOVERED:
+	case V4L2_EVENT_VIDC_LOAD_SHED:
+	case V4L2_EVENT_VIDC_BITSTREAM_SIZE:
 		rc = v4l2_event_subscribe(&inst->event_handler, sub, MAX_EVENTS, NULL);
 		break;
 	case V4L2_EVENT_CTRL:
@@ -1799,6 +1866,9 @@ int msm_venc_inst_init(struct msm_vidc_inst *inst)
 
 	core = inst->core;
 
+	INIT_DELAYED_WORK(&inst->encode_batch.work, msm_vidc_encode_batch_handler);
+	if (core->capabilities[ENCODE_BATCH_FPS].value)
+		inst->encode_batch.size = MAX_ENC_BATCH_SIZE;
 	if (core->capabilities[DCVS].value)
 		inst->power.dcvs_mode = true;
 
@@ -1895,6 +1965,8 @@ int msm_venc_inst_deinit(struct msm_vidc_inst *inst)
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
+	/* cancel pending batch work */
+	cancel_delayed_work(&inst->encode_batch.work);
 	rc = msm_vidc_ctrl_deinit(inst);
 	if (rc)
 		return rc;
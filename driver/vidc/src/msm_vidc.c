@@ -857,6 +857,8 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 	int rc = 0;
 	struct msm_vidc_inst *inst = NULL;
 	struct msm_vidc_core *core;
+	bool cold;
+	u64 start_ns = ktime_get_ns();
 	int i = 0;
 
 	d_vpr_h("%s: %s\n", __func__, video_banner);
@@ -873,6 +875,7 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 		return NULL;
 	}
 
+	cold = msm_vidc_fw_warm_open(core);
 	rc = msm_vidc_core_init(core);
 	if (rc)
 		return NULL;
@@ -880,6 +883,7 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 	rc = msm_vidc_core_init_wait(core);
 	if (rc)
 		return NULL;
+	msm_vidc_fw_warm_ready(core, start_ns, cold);
 
 	rc = msm_vidc_vmem_alloc(sizeof(*inst), (void **)&inst, "inst memory");
 	if (rc)
@@ -912,7 +916,6 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 		msm_vidc_vmem_free((void **)&inst);
 		return NULL;
 	}
-	INIT_LIST_HEAD(&inst->caps_list);
 	INIT_LIST_HEAD(&inst->timestamps.list);
 	INIT_LIST_HEAD(&inst->ts_reorder.list);
 	INIT_LIST_HEAD(&inst->buffers.input.list);
@@ -963,14 +966,8 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 	for (i = 0; i < MAX_SIGNAL; i++)
 		init_completion(&inst->completions[i]);
 
-	inst->workq = create_singlethread_workqueue("workq");
-	if (!inst->workq) {
-		i_vpr_e(inst, "%s: create workq failed\n", __func__);
-		goto error;
-	}
-
-	INIT_DELAYED_WORK(&inst->stats_work, msm_vidc_stats_handler);
 	INIT_WORK(&inst->stability_work, msm_vidc_stability_handler);
+	INIT_WORK(&inst->cmdq_error_work, msm_vidc_cmdq_error_handler);
 
 	rc = msm_vidc_vmem_alloc(sizeof(struct msm_vidc_inst_capability),
 		(void **)&inst->capabilities, "inst capability");
@@ -1046,7 +1043,7 @@ int msm_vidc_close(void *instance)
 	inst_unlock(inst, __func__);
 	client_unlock(inst, __func__);
 	cancel_stability_work_sync(inst);
-	cancel_stats_work_sync(inst);
+	cancel_work_sync(&inst->cmdq_error_work);
 	msm_vidc_show_stats(inst);
 	put_inst(inst);
 	msm_vidc_schedule_core_deinit(core);
@@ -121,6 +121,16 @@ u32 msm_vidc_input_extra_count(struct msm_vidc_inst *inst)
 		/* add dcvs buffers, if platform supports dcvs */
 		if (core->capabilities[DCVS].value)
 			count = DCVS_ENC_EXTRA_INPUT_BUFFERS;
+		/*
+		 * if high fps encode may batch input, ensure client
+		 * can keep a full batch held in driver
+		 */
+		if (inst->encode_batch.size &&
+			inst->capabilities->cap[ENC_AUTO_BATCH].value &&
+			msm_vidc_get_fps(inst) >=
+				core->capabilities[ENCODE_BATCH_FPS].value &&
+			count < inst->encode_batch.size)
+			count = inst->encode_batch.size;
 	}
 
 	return count;
@@ -470,3 +480,140 @@ u32 msm_vidc_encoder_output_meta_size(struct msm_vidc_inst *inst)
 {
 	return MSM_VIDC_METADATA_SIZE;
 }
+
+bool msm_vidc_is_adaptive_bitstream_size(struct msm_vidc_inst *inst)
+{
+	if (!inst || !inst->capabilities) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return false;
+	}
+
+	/* overflow is fatal for image session, so always use worst case size */
+	if (is_image_session(inst))
+		return false;
+
+	/* client configured size takes precedence */
+	if (is_decode_session(inst) &&
+		inst->capabilities->cap[BITSTREAM_SIZE_OVERWRITE].value)
+		return false;
+
+	return !!inst->capabilities->cap[ADAPTIVE_BITSTREAM_SIZE].value;
+}
+
+/*
+ * Returns the bitstream buffer size to be reported to client. Once enough
+ * frames were observed, recommended size is max filled size with headroom,
+ * but never more than the worst case size computed from resolution.
+ */
+u32 msm_vidc_get_bitstream_size(struct msm_vidc_inst *inst, u32 size)
+{
+	struct msm_vidc_bitstream_size *bs;
+
+	if (!msm_vidc_is_adaptive_bitstream_size(inst))
+		return size;
+
+	bs = &inst->bitstream_size;
+	if (!bs->recommended || bs->recommended >= size)
+		return size;
+
+	return bs->recommended;
+}
+
+void msm_vidc_reset_bitstream_size(struct msm_vidc_inst *inst)
+{
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	inst->bitstream_size.max_filled = 0;
+	inst->bitstream_size.samples = 0;
+	inst->bitstream_size.recommended = 0;
+}
+
+bool msm_vidc_is_bitstream_shrunk(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	enum msm_vidc_port_type port;
+
+	if (!inst || !buf) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return false;
+	}
+
+	if (!msm_vidc_is_adaptive_bitstream_size(inst))
+		return false;
+
+	port = is_decode_session(inst) ? INPUT_PORT : OUTPUT_PORT;
+	return buf->buffer_size &&
+		buf->buffer_size < inst->fmts[port].fmt.pix_mp.plane_fmt[0].sizeimage;
+}
+
+static void msm_vidc_raise_bitstream_size_event(struct msm_vidc_inst *inst)
+{
+	struct v4l2_event event = {0};
+	u32 *data = (u32 *)event.u.data;
+	enum msm_vidc_port_type port;
+
+	port = is_decode_session(inst) ? INPUT_PORT : OUTPUT_PORT;
+	event.type = V4L2_EVENT_VIDC_BITSTREAM_SIZE;
+	data[0] = inst->fmts[port].type;
+	data[1] = inst->fmts[port].fmt.pix_mp.plane_fmt[0].sizeimage;
+	i_vpr_h(inst, "%s: reallocate %s buffers with size %u\n",
+		__func__, port == INPUT_PORT ? "input" : "output", data[1]);
+	v4l2_event_queue_fh(&inst->event_handler, &event);
+}
+
+int msm_vidc_update_bitstream_size(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, bool overflow)
+{
+	struct msm_vidc_bitstream_size *bs;
+	u32 size;
+
+	if (!inst || !buf) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!msm_vidc_is_adaptive_bitstream_size(inst))
+		return 0;
+
+	bs = &inst->bitstream_size;
+
+	/*
+	 * fallback to worst case size if firmware reported overflow, buffer
+	 * was completely filled (possibly truncated) or headroom is consumed.
+	 */
+	if (overflow || (buf->buffer_size && buf->data_size >= buf->buffer_size) ||
+		(bs->recommended && buf->data_size > bs->recommended)) {
+		if (bs->recommended)
+			i_vpr_h(inst,
+				"%s: fallback to worst case size, data_size %u recommended %u\n",
+				__func__, buf->data_size, bs->recommended);
+		bs->fallback_count++;
+		msm_vidc_reset_bitstream_size(inst);
+		/* client sized this buffer from a recommendation, have it grow */
+		if (msm_vidc_is_bitstream_shrunk(inst, buf))
+			msm_vidc_raise_bitstream_size_event(inst);
+		return 0;
+	}
+
+	if (buf->data_size > bs->max_filled)
+		bs->max_filled = buf->data_size;
+	if (bs->samples < ADAPTIVE_BITSTREAM_MIN_SAMPLES) {
+		bs->samples++;
+		return 0;
+	}
+
+	size = bs->max_filled * ADAPTIVE_BITSTREAM_HEADROOM;
+	size = ALIGN(max_t(u32, size, ADAPTIVE_BITSTREAM_MIN_SIZE), SZ_4K);
+
+	/* recommendation only grows, until a fallback resets it */
+	if (size > bs->recommended) {
+		i_vpr_l(inst, "%s: recommended size %u -> %u, max filled %u\n",
+			__func__, bs->recommended, size, bs->max_filled);
+		bs->recommended = size;
+	}
+
+	return 0;
+}
@@ -4,6 +4,7 @@
  */
 /* Copyright (c) 2022. Qualcomm Innovation Center, Inc. All rights reserved. */
 
+#include <linux/bsearch.h>
 #include "msm_vidc_control.h"
 #include "msm_vidc_debug.h"
 #include "hfi_packet.h"
@@ -19,8 +20,6 @@
 		(a) = MIN_QP_8BIT;             \
 }
 
-extern struct msm_vidc_core *g_core;
-
 static bool is_priv_ctrl(u32 id)
 {
 	bool private = false;
@@ -212,19 +211,25 @@ static const char * const * msm_vidc_get_qmenu_type(
 	}
 }
 
-static inline bool has_parents(struct msm_vidc_inst_cap *cap)
+static inline const struct msm_vidc_inst_cap_dependency *get_cap_dependency(
+	struct msm_vidc_inst *inst, enum msm_vidc_inst_capability_type cap_id)
+{
+	return &inst->capabilities->dependency[cap_id];
+}
+
+static inline bool has_parents(const struct msm_vidc_inst_cap_dependency *dep)
 {
-	return !!cap->parents[0];
+	return !!dep->parents[0];
 }
 
-static inline bool has_childrens(struct msm_vidc_inst_cap *cap)
+static inline bool has_childrens(const struct msm_vidc_inst_cap_dependency *dep)
 {
-	return !!cap->children[0];
+	return !!dep->children[0];
 }
 
-static inline bool is_root(struct msm_vidc_inst_cap *cap)
+static inline bool is_root(const struct msm_vidc_inst_cap_dependency *dep)
 {
-	return !has_parents(cap);
+	return !has_parents(dep);
 }
 
 static inline bool is_valid_cap_id(enum msm_vidc_inst_capability_type cap_id)
@@ -237,23 +242,6 @@ static inline bool is_valid_cap(struct msm_vidc_inst_cap *cap)
 	return is_valid_cap_id(cap->cap_id);
 }
 
-static inline bool is_all_parents_visited(
-	struct msm_vidc_inst_cap *cap, bool lookup[INST_CAP_MAX]) {
-	bool found = true;
-	int i;
-
-	for (i = 0; i < MAX_CAP_PARENTS; i++) {
-		if (cap->parents[i] == INST_CAP_NONE)
-			continue;
-
-		if (!lookup[cap->parents[i]]) {
-			found = false;
-			break;
-		}
-	}
-	return found;
-}
-
 static int add_node_list(struct list_head *list, enum msm_vidc_inst_capability_type cap_id)
 {
 	int rc = 0;
@@ -271,61 +259,6 @@ static int add_node_list(struct list_head *list, enum msm_vidc_inst_capability_t
 	return rc;
 }
 
-static int add_node(
-	struct list_head *list, struct msm_vidc_inst_cap *rcap, bool lookup[INST_CAP_MAX])
-{
-	int rc = 0;
-
-	if (lookup[rcap->cap_id])
-		return 0;
-
-	rc = add_node_list(list, rcap->cap_id);
-	if (rc)
-		return rc;
-
-	lookup[rcap->cap_id] = true;
-	return 0;
-}
-
-static int swap_node(struct msm_vidc_inst_cap *rcap,
-	struct list_head *src_list, bool src_lookup[INST_CAP_MAX],
-	struct list_head *dest_list, bool dest_lookup[INST_CAP_MAX])
-{
-	struct msm_vidc_inst_cap_entry *entry, *temp;
-	bool found = false;
-
-	/* cap must be available in src and not present in dest */
-	if (!src_lookup[rcap->cap_id] || dest_lookup[rcap->cap_id]) {
-		d_vpr_e("%s: not found in src or already found in dest for cap %s\n",
-			__func__, cap_name(rcap->cap_id));
-		return -EINVAL;
-	}
-
-	/* check if entry present in src_list */
-	list_for_each_entry_safe(entry, temp, src_list, list) {
-		if (entry->cap_id == rcap->cap_id) {
-			found = true;
-			break;
-		}
-	}
-
-	if (!found) {
-		d_vpr_e("%s: cap %s not found in src list\n",
-			__func__, cap_name(rcap->cap_id));
-		return -EINVAL;
-	}
-
-	/* remove from src_list */
-	list_del_init(&entry->list);
-	src_lookup[rcap->cap_id] = false;
-
-	/* add it to dest_list */
-	list_add_tail(&entry->list, dest_list);
-	dest_lookup[rcap->cap_id] = true;
-
-	return 0;
-}
-
 static int msm_vidc_packetize_control(struct msm_vidc_inst *inst,
 	enum msm_vidc_inst_capability_type cap_id, u32 payload_type,
 	void *hfi_val, u32 payload_size, const char *func)
@@ -365,14 +298,33 @@ static int msm_vidc_packetize_control(struct msm_vidc_inst *inst,
 	return 0;
 }
 
+static int cap_v4l2_map_search(const void *key, const void *elt)
+{
+	u32 id = *(const u32 *)key;
+	const struct msm_vidc_cap_v4l2_map *map = elt;
+
+	if (id == map->v4l2_id)
+		return 0;
+
+	return id < map->v4l2_id ? -1 : 1;
+}
+
 static enum msm_vidc_inst_capability_type msm_vidc_get_cap_id(
 	struct msm_vidc_inst *inst, u32 id)
 {
 	enum msm_vidc_inst_capability_type i = INST_CAP_NONE + 1;
 	struct msm_vidc_inst_capability *capability;
 	enum msm_vidc_inst_capability_type cap_id = INST_CAP_NONE;
+	const struct msm_vidc_cap_v4l2_map *map;
 
 	capability = inst->capabilities;
+	/* use per codec index built at core init */
+	if (capability->v4l2_map) {
+		map = bsearch(&id, capability->v4l2_map, capability->v4l2_map_count,
+			sizeof(*map), cap_v4l2_map_search);
+		return map ? map->cap_id : INST_CAP_NONE;
+	}
+
 	do {
 		if (capability->cap[i].v4l2_id == id) {
 			cap_id = capability->cap[i].cap_id;
@@ -410,19 +362,19 @@ static int msm_vidc_add_capid_to_fw_list(struct msm_vidc_inst *inst,
 static int msm_vidc_add_children(struct msm_vidc_inst *inst,
 	enum msm_vidc_inst_capability_type cap_id)
 {
-	struct msm_vidc_inst_cap *cap;
+	const struct msm_vidc_inst_cap_dependency *dep;
 	int i, rc = 0;
 
-	cap = &inst->capabilities->cap[cap_id];
+	dep = get_cap_dependency(inst, cap_id);
 
 	for (i = 0; i < MAX_CAP_CHILDREN; i++) {
-		if (!cap->children[i])
+		if (!dep->children[i])
 			break;
 
-		if (!is_valid_cap_id(cap->children[i]))
+		if (!is_valid_cap_id(dep->children[i]))
 			continue;
 
-		rc = add_node_list(&inst->children_list, cap->children[i]);
+		rc = add_node_list(&inst->children_list, dep->children[i]);
 		if (rc)
 			return rc;
 	}
@@ -433,12 +385,13 @@ static int msm_vidc_add_children(struct msm_vidc_inst *inst,
 static bool is_parent_available(struct msm_vidc_inst *inst,
 	u32 cap_id, u32 check_parent, const char *func)
 {
+	const struct msm_vidc_inst_cap_dependency *dep;
 	int i = 0;
 	u32 cap_parent;
 
-	while (i < MAX_CAP_PARENTS &&
-		inst->capabilities->cap[cap_id].parents[i]) {
-		cap_parent = inst->capabilities->cap[cap_id].parents[i];
+	dep = get_cap_dependency(inst, cap_id);
+	while (i < MAX_CAP_PARENTS && dep->parents[i]) {
+		cap_parent = dep->parents[i];
 		if (cap_parent == check_parent) {
 			return true;
 		}
@@ -555,6 +508,7 @@ static int msm_vidc_adjust_cap(struct msm_vidc_inst *inst,
 	struct v4l2_ctrl *ctrl, const char *func)
 {
 	struct msm_vidc_inst_cap *cap;
+	int (*adjust)(void *inst, struct v4l2_ctrl *ctrl);
 	int rc = 0;
 
 	/* validate cap_id */
@@ -567,14 +521,15 @@ static int msm_vidc_adjust_cap(struct msm_vidc_inst *inst,
 		return 0;
 
 	/* check if adjust supported */
-	if (!cap->adjust) {
+	adjust = get_cap_dependency(inst, cap_id)->adjust;
+	if (!adjust) {
 		if (ctrl)
 			msm_vidc_update_cap_value(inst, cap_id, ctrl->val, func);
 		return 0;
 	}
 
 	/* call adjust */
-	rc = cap->adjust(inst, ctrl);
+	rc = adjust(inst, ctrl);
 	if (rc) {
 		i_vpr_e(inst, "%s: adjust cap failed for %s\n", func, cap_name(cap_id));
 		return rc;
@@ -588,6 +543,7 @@ static int msm_vidc_set_cap(struct msm_vidc_inst *inst,
 	const char *func)
 {
 	struct msm_vidc_inst_cap *cap;
+	int (*set)(void *inst, enum msm_vidc_inst_capability_type cap_id);
 	int rc = 0;
 
 	/* validate cap_id */
@@ -600,11 +556,12 @@ static int msm_vidc_set_cap(struct msm_vidc_inst *inst,
 		return 0;
 
 	/* check if set supported */
-	if (!cap->set)
+	set = get_cap_dependency(inst, cap_id)->set;
+	if (!set)
 		return 0;
 
 	/* call set */
-	rc = cap->set(inst, cap_id);
+	rc = set(inst, cap_id);
 	if (rc) {
 		i_vpr_e(inst, "%s: set cap failed for %s\n", func, cap_name(cap_id));
 		return rc;
@@ -673,7 +630,7 @@ static int msm_vidc_adjust_dynamic_property(struct msm_vidc_inst *inst,
 			goto error;
 		}
 
-		if (!capability->cap[entry->cap_id].adjust) {
+		if (!get_cap_dependency(inst, entry->cap_id)->adjust) {
 			i_vpr_e(inst, "%s: child cap must have ajdust function %s\n",
 				__func__, cap_name(entry->cap_id));
 			rc = -EINVAL;
@@ -1038,7 +995,7 @@ int msm_v4l2_op_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
 
 	inst = container_of(ctrl->handler,
 			    struct msm_vidc_inst, ctrl_handler);
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: could not find inst for ctrl %s id %#x\n",
 			__func__, ctrl->name, ctrl->id);
@@ -1165,7 +1122,7 @@ int msm_v4l2_op_s_ctrl(struct v4l2_ctrl *ctrl)
 
 	inst = container_of(ctrl->handler,
 		struct msm_vidc_inst, ctrl_handler);
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst || !inst->capabilities) {
 		d_vpr_e("%s: invalid parameters for inst\n", __func__);
 		return -EINVAL;
@@ -1221,6 +1178,11 @@ int msm_v4l2_op_s_ctrl(struct v4l2_ctrl *ctrl)
 			goto unlock;
 	} else {
 		/* dynamic case */
+		/* settings apply from next frame, so release held input first */
+		rc = msm_vidc_flush_encode_batch(inst);
+		if (rc)
+			goto unlock;
+
 		rc = msm_vidc_adjust_dynamic_property(inst, cap_id, ctrl);
 		if (rc)
 			goto unlock;
@@ -3218,193 +3180,151 @@ int msm_vidc_adjust_delivery_mode(void *instance, struct v4l2_ctrl *ctrl)
 	return 0;
 }
 
-int msm_vidc_prepare_dependency_list(struct msm_vidc_inst *inst)
+static bool is_all_parents_visited(
+	const struct msm_vidc_inst_cap_dependency *dep, bool lookup[INST_CAP_MAX])
 {
-	struct list_head root_list, opt_list;
-	struct msm_vidc_inst_capability *capability;
-	struct msm_vidc_inst_cap *cap, *rcap;
-	struct msm_vidc_inst_cap_entry *entry = NULL, *temp = NULL;
-	bool root_visited[INST_CAP_MAX];
-	bool opt_visited[INST_CAP_MAX];
-	int tmp_count_total, tmp_count, num_nodes = 0;
-	int i, rc = 0;
+	int i;
 
-	if (!inst || !inst->capabilities) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return -EINVAL;
-	}
-	capability = inst->capabilities;
+	for (i = 0; i < MAX_CAP_PARENTS; i++) {
+		if (dep->parents[i] == INST_CAP_NONE)
+			continue;
 
-	if (!list_empty(&inst->caps_list)) {
-		i_vpr_h(inst, "%s: dependency list already prepared\n", __func__);
-		return 0;
+		if (!lookup[dep->parents[i]])
+			return false;
 	}
 
-	/* init local list and lookup table entries */
-	INIT_LIST_HEAD(&root_list);
-	INIT_LIST_HEAD(&opt_list);
-	memset(&root_visited, 0, sizeof(root_visited));
-	memset(&opt_visited, 0, sizeof(opt_visited));
+	return true;
+}
+
+/*
+ * Prepare adjust/set order for one codec, parents ahead of children.
+ * Graph is fixed per codec, so this runs once at core init and all
+ * instances of the codec share the resulting array.
+ */
+int msm_vidc_prepare_dependency_list(struct msm_vidc_inst_capability *capability,
+	enum msm_vidc_inst_capability_type *order, u32 *count)
+{
+	const struct msm_vidc_inst_cap_dependency *dep;
+	enum msm_vidc_inst_capability_type cap_id;
+	bool added[INST_CAP_MAX];
+	u32 num_caps = 0, num_added = 0, prev_added;
+	int i, j;
+
+	if (!capability || !capability->dependency || !order || !count) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+	*count = 0;
+	memset(&added, 0, sizeof(added));
 
 	/* populate root nodes first */
 	for (i = 1; i < INST_CAP_MAX; i++) {
-		rcap = &capability->cap[i];
-		if (!is_valid_cap(rcap))
+		if (!is_valid_cap(&capability->cap[i]))
 			continue;
 
 		/* sanitize cap value */
-		if (i != rcap->cap_id) {
-			i_vpr_e(inst, "%s: cap id mismatch. expected %s, actual %s\n",
-				__func__, cap_name(i), cap_name(rcap->cap_id));
-			rc = -EINVAL;
-			goto error;
+		if (i != capability->cap[i].cap_id) {
+			d_vpr_e("%s: cap id mismatch. expected %s, actual %s\n",
+				__func__, cap_name(i), cap_name(capability->cap[i].cap_id));
+			return -EINVAL;
 		}
 
-		/* add all root nodes */
-		if (is_root(rcap)) {
-			rc = add_node(&root_list, rcap, root_visited);
-			if (rc)
-				goto error;
-		} else {
-			rc = add_node(&opt_list, rcap, opt_visited);
-			if (rc)
-				goto error;
+		num_caps++;
+		if (is_root(&capability->dependency[i])) {
+			order[num_added++] = i;
+			added[i] = true;
 		}
 	}
 
-	/* add all dependent parents */
-	list_for_each_entry_safe(entry, temp, &root_list, list) {
-		rcap = &capability->cap[entry->cap_id];
-		/* skip leaf node */
-		if (!has_childrens(rcap))
+	/* add children whose parents are all present, in discovery order */
+	for (i = 0; i < num_added; i++) {
+		dep = &capability->dependency[order[i]];
+		if (!has_childrens(dep))
 			continue;
 
-		for (i = 0; i < MAX_CAP_CHILDREN; i++) {
-			if (!rcap->children[i])
+		for (j = 0; j < MAX_CAP_CHILDREN; j++) {
+			cap_id = dep->children[j];
+			if (!cap_id)
 				break;
 
-			if (!is_valid_cap_id(rcap->children[i]))
-				continue;
-
-			cap = &capability->cap[rcap->children[i]];
-			if (!is_valid_cap(cap))
+			if (!is_valid_cap_id(cap_id) ||
+				!is_valid_cap(&capability->cap[cap_id]) ||
+				added[cap_id])
 				continue;
 
-			/**
-			 * if child node is already part of root list
-			 * then no need to add it again.
-			 */
-			if (root_visited[cap->cap_id])
-				continue;
-
-			/**
-			 * if child node's all parents are already present in root list
-			 * then add it to root list else remains in optional list.
-			 */
-			if (is_all_parents_visited(cap, root_visited)) {
-				rc = swap_node(cap,
-						&opt_list, opt_visited, &root_list, root_visited);
-				if (rc)
-					goto error;
+			if (is_all_parents_visited(&capability->dependency[cap_id], added)) {
+				order[num_added++] = cap_id;
+				added[cap_id] = true;
 			}
 		}
 	}
 
-	/* find total optional list entries */
-	list_for_each_entry(entry, &opt_list, list)
-		num_nodes++;
-
-	/* used for loop detection */
-	tmp_count_total = num_nodes;
-	tmp_count = num_nodes;
-
-	/* sort final outstanding nodes */
-	list_for_each_entry_safe(entry, temp, &opt_list, list) {
-		/* initially remove entry from opt list */
-		list_del_init(&entry->list);
-		opt_visited[entry->cap_id] = false;
-		tmp_count--;
-		cap = &capability->cap[entry->cap_id];
+	/* sort outstanding nodes, a pass without progress means a loop */
+	while (num_added < num_caps) {
+		prev_added = num_added;
+		for (i = 1; i < INST_CAP_MAX; i++) {
+			if (added[i] || !is_valid_cap(&capability->cap[i]))
+				continue;
 
-		/**
-		 * if all parents are visited then add this entry to
-		 * root list else add it to the end of optional list.
-		 */
-		if (is_all_parents_visited(cap, root_visited)) {
-			list_add_tail(&entry->list, &root_list);
-			root_visited[entry->cap_id] = true;
-			tmp_count_total--;
-		} else {
-			list_add_tail(&entry->list, &opt_list);
-			opt_visited[entry->cap_id] = true;
+			if (is_all_parents_visited(&capability->dependency[i], added)) {
+				order[num_added++] = i;
+				added[i] = true;
+			}
 		}
 
-		/* detect loop */
-		if (!tmp_count) {
-			if (num_nodes == tmp_count_total) {
-				i_vpr_e(inst, "%s: loop detected in subgraph %d\n",
-					__func__, num_nodes);
-				rc = -EINVAL;
-				goto error;
+		if (num_added == prev_added) {
+			d_vpr_e("%s: loop detected in subgraph %d, codec %#x domain %#x\n",
+				__func__, num_caps - num_added, capability->codec,
+				capability->domain);
+			for (i = 1; i < INST_CAP_MAX; i++) {
+				if (!added[i] && is_valid_cap(&capability->cap[i]))
+					d_vpr_e("%s: unresolved: %s\n", __func__, cap_name(i));
 			}
-			num_nodes = tmp_count_total;
-			tmp_count = tmp_count_total;
+			return -EINVAL;
 		}
 	}
 
-	/* expecting opt_list to be empty */
-	if (!list_empty(&opt_list)) {
-		i_vpr_e(inst, "%s: opt_list is not empty\n", __func__);
-		rc = -EINVAL;
-		goto error;
-	}
-
-	/* move elements to &inst->caps_list from local */
-	list_replace_init(&root_list, &inst->caps_list);
-
+	*count = num_added;
 	return 0;
-error:
-	list_for_each_entry_safe(entry, temp, &opt_list, list) {
-		i_vpr_e(inst, "%s: opt_list: %s\n", __func__, cap_name(entry->cap_id));
-		list_del_init(&entry->list);
-		msm_vidc_vmem_free((void **)&entry);
-	}
-	list_for_each_entry_safe(entry, temp, &root_list, list) {
-		i_vpr_e(inst, "%s: root_list: %s\n", __func__, cap_name(entry->cap_id));
-		list_del_init(&entry->list);
-		msm_vidc_vmem_free((void **)&entry);
-	}
-	return rc;
 }
 
 /*
- * Loop over instance capabilities from caps_list
+ * Loop over codec dependency order prepared at core init
  * and call adjust and set function
  */
 int msm_vidc_adjust_set_v4l2_properties(struct msm_vidc_inst *inst)
 {
-	struct msm_vidc_inst_cap_entry *entry = NULL, *temp = NULL;
+	struct msm_vidc_inst_capability *capability;
+	enum msm_vidc_inst_capability_type cap_id;
+	u32 i;
 	int rc = 0;
 
 	if (!inst || !inst->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
+	capability = inst->capabilities;
 	i_vpr_h(inst, "%s()\n", __func__);
 
-	/* adjust all possible caps from caps_list */
-	list_for_each_entry_safe(entry, temp, &inst->caps_list, list) {
+	if (!capability->dependency_order || !capability->dependency_order_count) {
+		i_vpr_e(inst, "%s: dependency order not available\n", __func__);
+		return -EINVAL;
+	}
+
+	/* adjust all possible caps in dependency order */
+	for (i = 0; i < capability->dependency_order_count; i++) {
+		cap_id = capability->dependency_order[i];
 		i_vpr_l(inst, "%s: cap: id %3u, name %s\n", __func__,
-			entry->cap_id, cap_name(entry->cap_id));
+			cap_id, cap_name(cap_id));
 
-		rc = msm_vidc_adjust_cap(inst, entry->cap_id, NULL, __func__);
+		rc = msm_vidc_adjust_cap(inst, cap_id, NULL, __func__);
 		if (rc)
 			return rc;
 	}
 
-	/* set all caps from caps_list */
-	list_for_each_entry_safe(entry, temp, &inst->caps_list, list) {
-		rc = msm_vidc_set_cap(inst, entry->cap_id, __func__);
+	/* set all caps in dependency order */
+	for (i = 0; i < capability->dependency_order_count; i++) {
+		rc = msm_vidc_set_cap(inst, capability->dependency_order[i], __func__);
 		if (rc)
 			return rc;
 	}
@@ -4152,12 +4072,18 @@ int msm_vidc_set_session_priority(void *instance,
 	if (!is_critical_priority_session(inst))
 		hfi_value = inst->capabilities->cap[cap_id].value +
 			inst->capabilities->cap[FIRMWARE_PRIORITY_OFFSET].value;
+	/* keep an overload shed in place across client priority updates */
+	hfi_value += inst->shed.level;
 
 	rc = msm_vidc_packetize_control(inst, cap_id, HFI_PAYLOAD_U32,
 		&hfi_value, sizeof(u32), __func__);
 	if (rc)
 		return rc;
 
+	rc = msm_vidc_update_cmdq_class(inst);
+	if (rc)
+		return rc;
+
 	return rc;
 }
 
@@ -12,8 +12,6 @@
 #include "msm_vidc_internal.h"
 #include "msm_vidc_events.h"
 
-extern struct msm_vidc_core *g_core;
-
 #define MAX_SSR_STRING_LEN         64
 #define MAX_STABILITY_STRING_LEN   64
 #define MAX_DEBUG_LEVEL_STRING_LEN 15
@@ -29,16 +27,10 @@ static int debug_level_set(const char *val,
 	unsigned int dvalue;
 	int ret;
 
-	if (!kp || !kp->arg || !val) {
+	if (!kp || !val) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = *(struct msm_vidc_core **)kp->arg;
-
-	if (!core || !core->capabilities) {
-		d_vpr_e("%s: Invalid core/capabilities\n", __func__);
-		return -EINVAL;
-	}
 
 	ret = kstrtouint(val, 0, &dvalue);
 	if (ret)
@@ -46,23 +38,31 @@ static int debug_level_set(const char *val,
 
 	msm_vidc_debug = dvalue;
 
-	/* check only driver logmask */
-	if ((dvalue & 0xFF) > (VIDC_ERR | VIDC_HIGH)) {
-		core->capabilities[HW_RESPONSE_TIMEOUT].value = 2 * HW_RESPONSE_TIMEOUT_VALUE;
-		core->capabilities[SW_PC_DELAY].value         = 2 * SW_PC_DELAY_VALUE;
-		core->capabilities[FW_UNLOAD_DELAY].value     = 2 * FW_UNLOAD_DELAY_VALUE;
-	} else {
-		/* reset timeout values, if user reduces the logging */
-		core->capabilities[HW_RESPONSE_TIMEOUT].value = HW_RESPONSE_TIMEOUT_VALUE;
-		core->capabilities[SW_PC_DELAY].value         = SW_PC_DELAY_VALUE;
-		core->capabilities[FW_UNLOAD_DELAY].value     = FW_UNLOAD_DELAY_VALUE;
-	}
+	mutex_lock(&msm_vidc_cores_lock);
+	list_for_each_entry(core, &msm_vidc_cores, list) {
+		if (!core->capabilities)
+			continue;
 
-	d_vpr_h("timeout updated: hw_response %u, sw_pc %u, fw_unload %u, debug_level %#x\n",
-		core->capabilities[HW_RESPONSE_TIMEOUT].value,
-		core->capabilities[SW_PC_DELAY].value,
-		core->capabilities[FW_UNLOAD_DELAY].value,
-		msm_vidc_debug);
+		/* check only driver logmask */
+		if ((dvalue & 0xFF) > (VIDC_ERR | VIDC_HIGH)) {
+			core->capabilities[HW_RESPONSE_TIMEOUT].value = 2 * HW_RESPONSE_TIMEOUT_VALUE;
+			core->capabilities[SW_PC_DELAY].value         = 2 * SW_PC_DELAY_VALUE;
+			core->capabilities[FW_UNLOAD_DELAY].value     = 2 * FW_UNLOAD_DELAY_VALUE;
+		} else {
+			/* reset timeout values, if user reduces the logging */
+			core->capabilities[HW_RESPONSE_TIMEOUT].value = HW_RESPONSE_TIMEOUT_VALUE;
+			core->capabilities[SW_PC_DELAY].value         = SW_PC_DELAY_VALUE;
+			core->capabilities[FW_UNLOAD_DELAY].value     = FW_UNLOAD_DELAY_VALUE;
+		}
+
+		d_vpr_h("core%u timeout updated: hw_response %u, sw_pc %u, fw_unload %u, debug_level %#x\n",
+			core->id,
+			core->capabilities[HW_RESPONSE_TIMEOUT].value,
+			core->capabilities[SW_PC_DELAY].value,
+			core->capabilities[FW_UNLOAD_DELAY].value,
+			msm_vidc_debug);
+	}
+	mutex_unlock(&msm_vidc_cores_lock);
 
 	return 0;
 }
@@ -80,20 +80,13 @@ static const struct kernel_param_ops msm_vidc_debug_fops = {
 static int fw_dump_set(const char *val,
 	const struct kernel_param *kp)
 {
-	struct msm_vidc_core *core = NULL;
 	unsigned int dvalue;
 	int ret;
 
-	if (!kp || !kp->arg || !val) {
+	if (!kp || !val) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = *(struct msm_vidc_core **) kp->arg;
-
-	if (!core || !core->capabilities) {
-		d_vpr_e("%s: Invalid core/capabilities\n", __func__);
-		return -EINVAL;
-	}
 
 	ret = kstrtouint(val, 0, &dvalue);
 	if (ret)
@@ -116,8 +109,55 @@ static const struct kernel_param_ops msm_vidc_fw_dump_fops = {
 	.get = fw_dump_get,
 };
 
-module_param_cb(msm_vidc_debug, &msm_vidc_debug_fops, &g_core, 0644);
-module_param_cb(msm_vidc_fw_dump, &msm_vidc_fw_dump_fops, &g_core, 0644);
+module_param_cb(msm_vidc_debug, &msm_vidc_debug_fops, NULL, 0644);
+module_param_cb(msm_vidc_fw_dump, &msm_vidc_fw_dump_fops, NULL, 0644);
+
+static int cpumask_param_set(const char *val,
+	const struct kernel_param *kp)
+{
+	struct cpumask *mask;
+	cpumask_var_t tmp;
+	int ret;
+
+	if (!kp || !kp->arg || !val) {
+		d_vpr_e("%s: Invalid params\n", __func__);
+		return -EINVAL;
+	}
+	mask = (struct cpumask *)kp->arg;
+
+	if (!alloc_cpumask_var(&tmp, GFP_KERNEL))
+		return -ENOMEM;
+
+	ret = cpulist_parse(strim((char *)val), tmp);
+	if (!ret)
+		cpumask_copy(mask, tmp);
+	free_cpumask_var(tmp);
+
+	return ret;
+}
+
+static int cpumask_param_get(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%*pbl",
+		cpumask_pr_args((struct cpumask *)kp->arg));
+}
+
+static const struct kernel_param_ops msm_vidc_cpumask_fops = {
+	.set = cpumask_param_set,
+	.get = cpumask_param_get,
+};
+
+/* defaults for newly probed cores, runtime control is per core in sysfs */
+struct cpumask msm_vidc_irq_cpus;
+module_param_cb(msm_vidc_irq_cpus, &msm_vidc_cpumask_fops,
+	&msm_vidc_irq_cpus, 0644);
+
+unsigned int msm_vidc_irq_sched = MSM_VIDC_IRQ_SCHED_DEFAULT;
+module_param(msm_vidc_irq_sched, uint, 0644);
+
+/* workqueue priority is decided when the workqueue gets created */
+bool msm_vidc_workq_highpri = !true;
+module_param(msm_vidc_workq_highpri, bool, 0444);
 
 bool msm_vidc_lossless_encode = !true;
 EXPORT_SYMBOL(msm_vidc_lossless_encode);
@@ -207,6 +247,8 @@ static ssize_t core_info_read(struct file* file, char __user* buf,
 	struct msm_vidc_core *core = file->private_data;
 	char *cur, *end, *dbuf = NULL;
 	ssize_t len = 0;
+	u64 load;
+	u32 count = 0;
 	int rc = 0;
 
 	if (!core || !core->dt) {
@@ -230,6 +272,64 @@ static ssize_t core_info_read(struct file* file, char __user* buf,
 	cur += write_str(cur, end - cur,
 		"register_size: %u\n", core->dt->register_size);
 	cur += write_str(cur, end - cur, "irq: %u\n", core->dt->irq);
+	load = msm_vidc_get_core_load(core, &count);
+	cur += write_str(cur, end - cur, "core id: %u\n", core->id);
+	cur += write_str(cur, end - cur, "instances: %u\n", count);
+	cur += write_str(cur, end - cur, "load (mbps): %llu\n", load);
+	cur += write_str(cur, end - cur, "nrt headroom (mbps): %llu\n",
+		core->capabilities[MAX_MBPS].value > load ?
+		core->capabilities[MAX_MBPS].value - load : 0);
+	cur += write_str(cur, end - cur,
+		"cmdq backlog: %u (hwm %u), deferred %u, dropped %u\n",
+		core->cmdq_backlog.count, core->cmdq_backlog.count_hwm,
+		core->cmdq_backlog.deferred_count, core->cmdq_backlog.drop_count);
+	cur += write_str(cur, end - cur, "cmdq occupancy hwm: %u%%\n",
+		core->cmdq_backlog.occupancy_hwm);
+	cur += write_str(cur, end - cur,
+		"irq rate: %u/s, msg rate: %u/s, msgs per irq: %u.%02u\n",
+		core->irq_stats.irq_rate, core->irq_stats.msg_rate,
+		core->irq_stats.msgs_per_irq / 100,
+		core->irq_stats.msgs_per_irq % 100);
+	cur += write_str(cur, end - cur, "irqs: %llu, msgs: %llu, polls: %llu\n",
+		core->irq_stats.total_irqs, core->irq_stats.total_msgs,
+		core->irq_stats.poll_count);
+	cur += write_str(cur, end - cur, "irq cpus: %*pbl, irq sched: %u\n",
+		cpumask_pr_args(&core->irq_cpus), core->irq_sched);
+	cur += write_str(cur, end - cur,
+		"llcc: %s, est ddr saving %llu kBps, activations %u, releases %u\n",
+		core->dt->sys_cache_res_set ? "set" : "released",
+		core->sys_cache.ddr_saved, core->sys_cache.activations,
+		core->sys_cache.releases);
+	cur += write_str(cur, end - cur, "rt clock demand %llu capacity %llu, overloads %u\n",
+		core->load_shed.demand, core->load_shed.capacity,
+		core->load_shed.overload_count);
+	cur += write_str(cur, end - cur, "nrt sched: rounds %u, sliced %u, waiting %u\n",
+		core->nrt_sched.rounds, core->nrt_sched.sliced_rounds,
+		core->nrt_sched.waiting);
+	cur += write_str(cur, end - cur, "thermal state: %lu/%lu, throttled votes %u\n",
+		core->thermal.state, core->thermal.max_state,
+		core->thermal.throttle_count);
+	cur += write_str(cur, end - cur, "fw dumps: %u, rate limited %u\n",
+		core->fw_dump.count, core->fw_dump.skip_count);
+	cur += write_str(cur, end - cur,
+		"fw: opens warm %u cold %u, preloads %u, unloads %u, idle avg %u ms, ready %u us\n",
+		core->fw_warm.warm_opens, core->fw_warm.cold_opens,
+		core->fw_warm.preloads, core->fw_warm.unloads,
+		core->fw_warm.idle_avg_ms, core->fw_warm.ready_us);
+	cur += write_str(cur, end - cur,
+		"pc: predicted gap %u us, resume cost %u us, backoff %u\n",
+		core->pc_predictor.gap_us, core->pc_predictor.resume_cost_us,
+		core->pc_predictor.backoff);
+	cur += write_str(cur, end - cur,
+		"pc: collapses %u (fast %u), resumes %u, mispredict short %u busy %u\n",
+		core->pc_predictor.collapse_count, core->pc_predictor.fast_count,
+		core->pc_predictor.resume_count, core->pc_predictor.mispredict_short,
+		core->pc_predictor.mispredict_busy);
+	cur += write_str(cur, end - cur,
+		"pc residency ms: <10 %u, <50 %u, <100 %u, <500 %u, <1000 %u, >=1000 %u\n",
+		core->pc_predictor.residency[0], core->pc_predictor.residency[1],
+		core->pc_predictor.residency[2], core->pc_predictor.residency[3],
+		core->pc_predictor.residency[4], core->pc_predictor.residency[5]);
 
 	len = simple_read_from_buffer(buf, count, ppos,
 		dbuf, cur - dbuf);
@@ -423,7 +523,10 @@ struct dentry *msm_vidc_debugfs_init_core(void *core_in)
 	}
 	parent = core->debugfs_parent;
 
-	snprintf(debugfs_name, MAX_DEBUGFS_NAME, "core");
+	if (core->id)
+		snprintf(debugfs_name, MAX_DEBUGFS_NAME, "core%u", core->id);
+	else
+		snprintf(debugfs_name, MAX_DEBUGFS_NAME, "core");
 	dir = debugfs_create_dir(debugfs_name, parent);
 	if (IS_ERR_OR_NULL(dir)) {
 		dir = NULL;
@@ -541,6 +644,57 @@ static ssize_t inst_info_read(struct file *file, char __user *buf,
 		inst->debug_count.ftb);
 	cur += write_str(cur, end - cur, "FBD Count: %d\n",
 		inst->debug_count.fbd);
+	cur += write_str(cur, end - cur, "Throughput: %u fps (peak %u)%s\n",
+		inst->throughput.fps, inst->throughput.peak_fps,
+		is_throughput_session(inst) ? " offline" : "");
+	cur += write_str(cur, end - cur, "DDR: %u kBps, llcc %u kBps, est llcc saving %u kBps\n",
+		inst->power.ddr_bw, inst->power.sys_cache_bw, inst->power.ddr_saved);
+	cur += write_str(cur, end - cur, "Load shed: %s, count %u\n",
+		inst->shed.level ? "yes" : "no", inst->shed.count);
+	if (is_throughput_session(inst))
+		cur += write_str(cur, end - cur,
+			"Time slice: %s, weight %u, run %llu ms, vruntime %llu ms, slices %u, preempts %u, frames %llu\n",
+			inst->nrt_slice.paused ? "waiting" : "running",
+			inst->nrt_slice.weight,
+			div_u64(inst->nrt_slice.run_ns, NSEC_PER_MSEC),
+			div_u64(inst->nrt_slice.vruntime_ns, NSEC_PER_MSEC),
+			inst->nrt_slice.slices, inst->nrt_slice.preempts,
+			inst->debug_count.ebd);
+	cur += write_str(cur, end - cur,
+		"Bitstream size: max filled %u recommended %u fallbacks %u\n",
+		inst->bitstream_size.max_filled,
+		inst->bitstream_size.recommended,
+		inst->bitstream_size.fallback_count);
+	if (inst->decode_batch.enable)
+		cur += write_str(cur, end - cur,
+			"Decode batch: size %u/%u timeout %u ms interval %u us flushes %u timeouts %u\n",
+			inst->decode_batch.cur_size, inst->decode_batch.size,
+			inst->decode_batch.timeout_ms,
+			inst->decode_batch.avg_interval_us,
+			inst->decode_batch.flush_count,
+			inst->decode_batch.timeout_count);
+	if (inst->encode_batch.enable)
+		cur += write_str(cur, end - cur,
+			"Encode batch: size %u/%u timeout %u ms flushes %u timeouts %u\n",
+			inst->encode_batch.cur_size, inst->encode_batch.size,
+			inst->encode_batch.timeout_ms,
+			inst->encode_batch.flush_count,
+			inst->encode_batch.timeout_count);
+	if (inst->image_stats.num_images)
+		cur += write_str(cur, end - cur,
+			"Image encode: count %u last %llu us max %llu us avg %llu us\n",
+			inst->image_stats.num_images,
+			inst->image_stats.last_latency_us,
+			inst->image_stats.max_latency_us,
+			div_u64(inst->image_stats.total_latency_us,
+				inst->image_stats.num_images));
+	if (inst->qbuf_batch.calls)
+		cur += write_str(cur, end - cur,
+			"Qbuf batch: calls %llu buffers %llu\n",
+			inst->qbuf_batch.calls, inst->qbuf_batch.buffers);
+	if (inst->recovery_count)
+		cur += write_str(cur, end - cur,
+			"Recovered from fw restart: %u\n", inst->recovery_count);
 
 	publish_unreleased_reference(inst, &cur, end);
 	len = simple_read_from_buffer(buf, count, ppos,
@@ -633,6 +787,28 @@ void msm_vidc_debugfs_deinit_inst(void *instance)
 	inst->debugfs_root = NULL;
 }
 
+static void msm_vidc_update_throughput(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_throughput *tp = &inst->throughput;
+	u64 now = ktime_get_ns();
+	u64 elapsed;
+
+	tp->window_frames++;
+	if (!tp->window_start_ns) {
+		tp->window_start_ns = now;
+		return;
+	}
+
+	elapsed = now - tp->window_start_ns;
+	if (elapsed < NSEC_PER_SEC)
+		return;
+
+	tp->fps = (u32)div64_u64((u64)tp->window_frames * NSEC_PER_SEC, elapsed);
+	tp->peak_fps = max(tp->peak_fps, tp->fps);
+	tp->window_frames = 0;
+	tp->window_start_ns = now;
+}
+
 void msm_vidc_debugfs_update(void *instance,
 	enum msm_vidc_debugfs_event e)
 {
@@ -657,6 +833,7 @@ void msm_vidc_debugfs_update(void *instance,
 		break;
 	case MSM_VIDC_DEBUGFS_EVENT_EBD:
 		inst->debug_count.ebd++;
+		msm_vidc_update_throughput(inst);
 		/*
 		 * Host needs to ensure FW atleast have 2 buffers available always
 		 * one for HW processing and another for fw processing in parallel
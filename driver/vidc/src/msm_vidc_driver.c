@@ -5,6 +5,9 @@
 
 #include <linux/iommu.h>
 #include <linux/workqueue.h>
+#include <linux/sort.h>
+#include <linux/interrupt.h>
+#include <linux/idr.h>
 #include <media/v4l2_vidc_extensions.h>
 #include "msm_media_info.h"
 
@@ -25,8 +28,6 @@
 #include "hfi_packet.h"
 #include "msm_vidc_events.h"
 
-extern struct msm_vidc_core *g_core;
-
 #define is_odd(val) ((val) % 2 == 1)
 #define in_range(val, min, max) (((min) <= (val)) && ((val) <= (max)))
 #define COUNT_BITS(a, out) {       \
@@ -50,6 +51,11 @@ extern struct msm_vidc_core *g_core;
 #define STABILITY_PAYLOAD_ID 0xFFFFFFFF00000000
 #define STABILITY_PAYLOAD_SHIFT 32
 
+/* all probed video cores, ordered by core id */
+LIST_HEAD(msm_vidc_cores);
+DEFINE_MUTEX(msm_vidc_cores_lock);
+static DEFINE_IDA(msm_vidc_core_ida);
+
 struct msm_vidc_cap_name {
 	enum msm_vidc_inst_capability_type cap_id;
 	char *name;
@@ -193,6 +199,9 @@ static const struct msm_vidc_cap_name cap_name_arr[] = {
 	{LOWLATENCY_MAX_BITRATE,         "LOWLATENCY_MAX_BITRATE"     },
 	{LAST_FLAG_EVENT_ENABLE,         "LAST_FLAG_EVENT_ENABLE"     },
 	{NUM_COMV,                       "NUM_COMV"                   },
+	{ADAPTIVE_BITSTREAM_SIZE,        "ADAPTIVE_BITSTREAM_SIZE"    },
+	{DECODE_BATCH_LATENCY,           "DECODE_BATCH_LATENCY"       },
+	{ENC_AUTO_BATCH,                 "ENC_AUTO_BATCH"             },
 	{PROFILE,                        "PROFILE"                    },
 	{ENH_LAYER_COUNT,                "ENH_LAYER_COUNT"            },
 	{BIT_RATE,                       "BIT_RATE"                   },
@@ -1894,6 +1903,14 @@ enum msm_vidc_allow msm_vidc_allow_qbuf(struct msm_vidc_inst *inst, u32 type)
 	if (port < 0)
 		return MSM_VIDC_DISALLOW;
 
+	/* fw restarting, recovery queues deferred buffers again */
+	if (inst->recovery_pending)
+		return MSM_VIDC_DEFER;
+
+	/* out of its time slice, nrt scheduler queues them on resume */
+	if (type == INPUT_MPLANE && inst->nrt_slice.paused)
+		return MSM_VIDC_DEFER;
+
 	/* defer queuing if streamon not completed */
 	if (!inst->bufq[port].vb2q->streaming)
 		return MSM_VIDC_DEFER;
@@ -2063,6 +2080,14 @@ int msm_vidc_process_drain(struct msm_vidc_inst *inst)
 		return -EINVAL;
 	}
 
+	/* drain must follow every input held back by the nrt scheduler */
+	if (inst->nrt_slice.paused) {
+		inst->nrt_slice.paused = false;
+		rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_INPUT);
+		if (rc)
+			return rc;
+	}
+
 	rc = venus_hfi_session_drain(inst, INPUT_PORT);
 	if (rc)
 		return rc;
@@ -2547,6 +2572,95 @@ int msm_vidc_get_mbs_per_frame(struct msm_vidc_inst *inst)
 	return NUM_MBS_PER_FRAME(height, width);
 }
 
+u32 msm_vidc_get_grid_tile_count(struct msm_vidc_inst *inst)
+{
+	if (!inst || !inst->capabilities) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return 0;
+	}
+
+	if (!is_image_encode_session(inst) || !inst->capabilities->cap[GRID].value)
+		return 1;
+
+	return DIV_ROUND_UP(inst->crop.width, HEIC_GRID_DIMENSION) *
+		DIV_ROUND_UP(inst->crop.height, HEIC_GRID_DIMENSION);
+}
+
+void msm_vidc_image_stats_etb(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	struct msm_vidc_image_stats *stats;
+	struct msm_vidc_image_pending *entry;
+
+	if (!inst || !buf) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+	stats = &inst->image_stats;
+
+	/* drop the oldest entry, if client queued more than tracked */
+	if (stats->count == MAX_PENDING_IMAGES) {
+		stats->head = (stats->head + 1) % MAX_PENDING_IMAGES;
+		stats->count--;
+		stats->tiles = 0;
+	}
+
+	entry = &stats->pending[(stats->head + stats->count) % MAX_PENDING_IMAGES];
+	entry->timestamp = buf->timestamp;
+	entry->start_us = ktime_get_ns() / 1000;
+	stats->count++;
+}
+
+void msm_vidc_image_stats_fbd(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	struct msm_vidc_image_stats *stats;
+	struct msm_vidc_image_pending *entry;
+	u64 latency_us;
+	u32 tiles;
+
+	if (!inst || !buf) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+	stats = &inst->image_stats;
+
+	if (!stats->count || !buf->data_size)
+		return;
+
+	/* image is complete once every grid tile is delivered */
+	tiles = msm_vidc_get_grid_tile_count(inst);
+	if (++stats->tiles < tiles)
+		return;
+
+	entry = &stats->pending[stats->head];
+	latency_us = ktime_get_ns() / 1000 - entry->start_us;
+	stats->head = (stats->head + 1) % MAX_PENDING_IMAGES;
+	stats->count--;
+	stats->tiles = 0;
+
+	stats->num_images++;
+	stats->last_latency_us = latency_us;
+	stats->total_latency_us += latency_us;
+	if (latency_us > stats->max_latency_us)
+		stats->max_latency_us = latency_us;
+
+	i_vpr_hp(inst, "%s: image %u ts %llu: %u tiles in %llu us\n",
+		__func__, stats->num_images, entry->timestamp, tiles, latency_us);
+}
+
+void msm_vidc_image_stats_reset(struct msm_vidc_inst *inst)
+{
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	inst->image_stats.head = 0;
+	inst->image_stats.count = 0;
+	inst->image_stats.tiles = 0;
+}
+
 int msm_vidc_get_fps(struct msm_vidc_inst *inst)
 {
 	int fps;
@@ -3398,23 +3512,48 @@ bool msm_vidc_is_super_buffer(struct msm_vidc_inst *inst)
 	return !!capability->cap[SUPER_FRAME].value;
 }
 
-static bool is_single_session(struct msm_vidc_inst *inst)
+/*
+ * Batching can run on several sessions at once (e.g. video wall) as long
+ * as every session is a realtime, non-lowlatency video decode and the
+ * aggregate load stays within the single session batching envelope.
+ */
+static bool is_batch_session_mix(struct msm_vidc_inst *inst)
 {
+	struct msm_vidc_inst_capability *capability;
+	struct msm_vidc_inst *instance;
 	struct msm_vidc_core *core;
-	u32 count = 0;
+	u64 mbps = 0, max_mbps;
+	bool allow = true;
 
-	if (!inst) {
+	if (!inst || !inst->core || !inst->capabilities) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return false;
 	}
 	core = inst->core;
+	capability = inst->capabilities;
+	max_mbps = (u64)capability->cap[BATCH_MBPF].value *
+		capability->cap[BATCH_FPS].value;
 
 	core_lock(core, __func__);
-	list_for_each_entry(inst, &core->instances, list)
-		count++;
+	list_for_each_entry(instance, &core->instances, list) {
+		if (!instance->capabilities || !is_decode_session(instance) ||
+			is_image_session(instance) || is_thumbnail_session(instance) ||
+			!is_realtime_session(instance) || is_lowlatency_session(instance)) {
+			allow = false;
+			break;
+		}
+		mbps += (u64)msm_vidc_get_mbs_per_frame(instance) *
+			msm_vidc_get_fps(instance);
+	}
 	core_unlock(core, __func__);
 
-	return count == 1;
+	if (allow && mbps > max_mbps) {
+		i_vpr_h(inst, "%s: aggregate mbps %llu exceeds %llu\n",
+			__func__, mbps, max_mbps);
+		allow = false;
+	}
+
+	return allow;
 }
 
 void msm_vidc_allow_dcvs(struct msm_vidc_inst *inst)
@@ -3453,6 +3592,12 @@ void msm_vidc_allow_dcvs(struct msm_vidc_inst *inst)
 		goto exit;
 	}
 
+	allow = !inst->encode_batch.enable;
+	if (!allow) {
+		i_vpr_h(inst, "%s: encode_batching enabled\n", __func__);
+		goto exit;
+	}
+
 	allow = !is_thumbnail_session(inst);
 	if (!allow) {
 		i_vpr_h(inst, "%s: thumbnail session\n", __func__);
@@ -3524,9 +3669,9 @@ bool msm_vidc_allow_decode_batch(struct msm_vidc_inst *inst)
 		goto exit;
 	}
 
-	allow = is_single_session(inst);
+	allow = is_batch_session_mix(inst);
 	if (!allow) {
-		i_vpr_h(inst, "%s: multiple sessions running\n", __func__);
+		i_vpr_h(inst, "%s: session mix doesn't allow batching\n", __func__);
 		goto exit;
 	}
 
@@ -3582,6 +3727,95 @@ exit:
 	return allow;
 }
 
+bool msm_vidc_allow_encode_batch(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_inst_capability *capability;
+	struct msm_vidc_core *core;
+	bool allow = false;
+	u32 value = 0;
+
+	if (!inst || !inst->core || !inst->capabilities) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return false;
+	}
+	core = inst->core;
+	capability = inst->capabilities;
+
+	allow = !!inst->encode_batch.size;
+	if (!allow) {
+		i_vpr_h(inst, "%s: core doesn't support batching\n", __func__);
+		goto exit;
+	}
+
+	allow = is_encode_session(inst);
+	if (!allow) {
+		i_vpr_h(inst, "%s: not an encoder session\n", __func__);
+		goto exit;
+	}
+
+	allow = !!capability->cap[ENC_AUTO_BATCH].value;
+	if (!allow) {
+		i_vpr_h(inst, "%s: disabled by client\n", __func__);
+		goto exit;
+	}
+
+	allow = !is_image_session(inst);
+	if (!allow) {
+		i_vpr_h(inst, "%s: image session\n", __func__);
+		goto exit;
+	}
+
+	allow = !msm_vidc_is_super_buffer(inst);
+	if (!allow) {
+		i_vpr_h(inst, "%s: client super buffer enabled\n", __func__);
+		goto exit;
+	}
+
+	allow = !capability->cap[INPUT_META_VIA_REQUEST].value;
+	if (!allow) {
+		i_vpr_h(inst, "%s: input meta via request\n", __func__);
+		goto exit;
+	}
+
+	allow = is_realtime_session(inst);
+	if (!allow) {
+		i_vpr_h(inst, "%s: non-realtime session\n", __func__);
+		goto exit;
+	}
+
+	allow = !is_lowlatency_session(inst);
+	if (!allow) {
+		i_vpr_h(inst, "%s: lowlatency session\n", __func__);
+		goto exit;
+	}
+
+	value = msm_vidc_get_fps(inst);
+	allow = value >= core->capabilities[ENCODE_BATCH_FPS].value;
+	if (!allow) {
+		i_vpr_h(inst, "%s: fps %u below %u\n", __func__,
+			value, core->capabilities[ENCODE_BATCH_FPS].value);
+		goto exit;
+	}
+
+	/* hold at most timeout worth of frames, so latency stays bounded */
+	inst->encode_batch.timeout_ms = core->capabilities[ENCODE_BATCH_TIMEOUT].value;
+	inst->encode_batch.cur_size = clamp_t(u32,
+		DIV_ROUND_UP(value * inst->encode_batch.timeout_ms, 1000),
+		1, inst->encode_batch.size);
+	allow = inst->encode_batch.cur_size > 1;
+	if (!allow) {
+		i_vpr_h(inst, "%s: batch window %u ms too small for fps %u\n",
+			__func__, inst->encode_batch.timeout_ms, value);
+		goto exit;
+	}
+
+exit:
+	i_vpr_hp(inst, "%s: batching: %s, size %u\n", __func__,
+		allow ? "enabled" : "disabled", inst->encode_batch.cur_size);
+
+	return allow;
+}
+
 static void msm_vidc_update_input_cr(struct msm_vidc_inst *inst, u32 idx, u32 cr)
 {
 	struct msm_vidc_input_cr_data *temp = NULL, *next = NULL;
@@ -3683,40 +3917,52 @@ int schedule_stats_work(struct msm_vidc_inst *inst)
 		return 0;
 	}
 	core = inst->core;
-	mod_delayed_work(inst->workq, &inst->stats_work,
-		msecs_to_jiffies(core->capabilities[STATS_TIMEOUT_MS].value));
 
-	return 0;
-}
-
-int cancel_stats_work_sync(struct msm_vidc_inst *inst)
-{
-	if (!inst) {
-		d_vpr_e("%s: Invalid arguments\n", __func__);
-		return -EINVAL;
-	}
-	cancel_delayed_work_sync(&inst->stats_work);
+	/* one periodic walk per core covers every streaming instance */
+	if (!delayed_work_pending(&core->stats_work))
+		mod_delayed_work(core->inst_workq, &core->stats_work,
+			msecs_to_jiffies(core->capabilities[STATS_TIMEOUT_MS].value));
 
 	return 0;
 }
 
 void msm_vidc_stats_handler(struct work_struct *work)
 {
-	struct msm_vidc_inst *inst;
+	struct msm_vidc_core *core;
+	struct msm_vidc_inst *inst, **insts = NULL;
+	u32 count = 0, num = 0, i;
 
-	inst = container_of(work, struct msm_vidc_inst, stats_work.work);
-	inst = get_inst_ref(g_core, inst);
-	if (!inst || !inst->packet) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return;
+	core = container_of(work, struct msm_vidc_core, stats_work.work);
+
+	/* pin instances under core lock, print them under their own lock */
+	core_lock(core, __func__);
+	list_for_each_entry(inst, &core->instances, list)
+		count++;
+	if (count && !msm_vidc_vmem_alloc(count * sizeof(*insts),
+			(void **)&insts, __func__)) {
+		list_for_each_entry(inst, &core->instances, list) {
+			if (!inst->packet || !inst->stats.time_ms)
+				continue;
+			if (kref_get_unless_zero(&inst->kref))
+				insts[num++] = inst;
+		}
 	}
+	core_unlock(core, __func__);
 
-	inst_lock(inst, __func__);
-	msm_vidc_print_stats(inst);
-	schedule_stats_work(inst);
-	inst_unlock(inst, __func__);
+	for (i = 0; i < num; i++) {
+		inst = insts[i];
+		inst_lock(inst, __func__);
+		if (inst->packet)
+			msm_vidc_print_stats(inst);
+		inst_unlock(inst, __func__);
+		put_inst(inst);
+	}
+	msm_vidc_vmem_free((void **)&insts);
 
-	put_inst(inst);
+	/* nothing is streaming, stay idle until the next streamon */
+	if (num)
+		mod_delayed_work(core->inst_workq, &core->stats_work,
+			msecs_to_jiffies(core->capabilities[STATS_TIMEOUT_MS].value));
 }
 
 static int msm_vidc_destroy_fence_array(struct msm_vidc_inst *inst, struct msm_vidc_buffer *buf)
@@ -3833,6 +4079,9 @@ static int msm_vidc_queue_buffer(struct msm_vidc_inst *inst, struct msm_vidc_buf
 	if (rc)
 		return rc;
 
+	if (is_image_encode_session(inst) && is_input_buffer(buf->type))
+		msm_vidc_image_stats_etb(inst, buf);
+
 	buf->attr &= ~MSM_VIDC_ATTR_DEFERRED;
 	buf->attr |= MSM_VIDC_ATTR_QUEUED;
 	if (meta) {
@@ -3892,7 +4141,8 @@ int msm_vidc_queue_deferred_buffers(struct msm_vidc_inst *inst, enum msm_vidc_bu
 {
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	int rc = 0;
+	bool batch;
+	int rc = 0, count = 0;
 
 	if (!inst || !buf_type) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -3905,15 +4155,85 @@ int msm_vidc_queue_deferred_buffers(struct msm_vidc_inst *inst, enum msm_vidc_bu
 
 	msm_vidc_scale_power(inst, true);
 
+	/* raise host to fw interrupt only once per encode batch */
+	batch = inst->encode_batch.enable && buf_type == MSM_VIDC_BUF_INPUT;
+	if (batch)
+		count = msm_vidc_num_buffers(inst, buf_type, MSM_VIDC_ATTR_DEFERRED);
+
 	list_for_each_entry(buf, &buffers->list, list) {
 		if (!(buf->attr & MSM_VIDC_ATTR_DEFERRED))
 			continue;
+		inst->encode_batch.hold_intr = batch && --count > 0;
 		rc = msm_vidc_queue_buffer(inst, buf);
 		if (rc)
-			return rc;
+			break;
 	}
+	inst->encode_batch.hold_intr = false;
 
-	return 0;
+	return rc;
+}
+
+int msm_vidc_flush_encode_batch(struct msm_vidc_inst *inst)
+{
+	enum msm_vidc_allow allow;
+	int rc = 0;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!inst->encode_batch.enable)
+		return 0;
+
+	cancel_delayed_work(&inst->encode_batch.work);
+	if (!msm_vidc_num_buffers(inst, MSM_VIDC_BUF_INPUT, MSM_VIDC_ATTR_DEFERRED))
+		return 0;
+
+	allow = msm_vidc_allow_qbuf(inst, INPUT_MPLANE);
+	if (allow != MSM_VIDC_ALLOW)
+		return 0;
+
+	inst->encode_batch.flush_count++;
+	rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_INPUT);
+	if (rc)
+		i_vpr_e(inst, "%s: queue batch buffers failed\n", __func__);
+
+	return rc;
+}
+
+void msm_vidc_qbuf_batch_begin(struct msm_vidc_inst *inst)
+{
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	inst->qbuf_batch.owner = current;
+	inst->qbuf_batch.scale = false;
+	inst->qbuf_batch.scale_buses = false;
+	inst->qbuf_batch.held = 0;
+}
+
+int msm_vidc_qbuf_batch_end(struct msm_vidc_inst *inst)
+{
+	int rc = 0;
+
+	if (!inst || !inst->core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	inst->qbuf_batch.owner = NULL;
+	if (inst->qbuf_batch.scale)
+		msm_vidc_scale_power(inst, inst->qbuf_batch.scale_buses);
+
+	/* one doorbell for every packet written during the batch */
+	if (inst->qbuf_batch.held)
+		rc = venus_hfi_raise_doorbell(inst->core);
+	inst->qbuf_batch.held = 0;
+
+	return rc;
 }
 
 int msm_vidc_queue_buffer_single(struct msm_vidc_inst *inst, struct vb2_buffer *vb2)
@@ -3953,7 +4273,13 @@ int msm_vidc_queue_buffer_single(struct msm_vidc_inst *inst, struct vb2_buffer *
 		goto exit;
 	}
 
-	msm_vidc_scale_power(inst, is_input_buffer(buf->type));
+	/* batched qbuf evaluates power once, after the whole batch */
+	if (inst->qbuf_batch.owner) {
+		inst->qbuf_batch.scale = true;
+		inst->qbuf_batch.scale_buses |= is_input_buffer(buf->type);
+	} else {
+		msm_vidc_scale_power(inst, is_input_buffer(buf->type));
+	}
 
 	rc = msm_vidc_queue_buffer(inst, buf);
 	if (rc)
@@ -4381,6 +4707,9 @@ int msm_vidc_vb2_buffer_done(struct msm_vidc_inst *inst,
 	vb2->timestamp = buf->timestamp;
 	vb2->planes[0].bytesused = buf->data_size + vb2->planes[0].data_offset;
 	vb2_buffer_done(vb2, state);
+	if (buf->type == MSM_VIDC_BUF_OUTPUT)
+		trace_msm_vidc_fbd_latency("fbd", inst->core->id,
+			div_u64(ktime_get_ns() - inst->core->irq_ts, NSEC_PER_USEC));
 
 	return 0;
 }
@@ -4627,6 +4956,7 @@ int msm_vidc_add_session(struct msm_vidc_inst *inst)
 		count++;
 
 	if (count < core->capabilities[MAX_SESSION_COUNT].value) {
+		inst->cmdq_realtime = is_realtime_session(inst);
 		list_add_tail(&inst->list, &core->instances);
 	} else {
 		i_vpr_e(inst, "%s: max limit %d already running %d sessions\n",
@@ -4663,6 +4993,11 @@ int msm_vidc_remove_session(struct msm_vidc_inst *inst)
 	list_for_each_entry(i, &core->instances, list)
 		count++;
 	i_vpr_h(inst, "%s: remaining sessions %d\n", __func__, count);
+	/* no session left to save ddr: drop llcc at the next power collapse */
+	if (!count) {
+		core->sys_cache.enable = false;
+		core->sys_cache.ddr_saved = 0;
+	}
 	core_unlock(core, __func__);
 
 	return 0;
@@ -4723,6 +5058,46 @@ error:
 	return rc;
 }
 
+int msm_vidc_session_streamon_prepare(struct msm_vidc_inst *inst)
+{
+	int rc = 0;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	if (inst->once_per_session_set)
+		return 0;
+
+	inst->once_per_session_set = true;
+	rc = msm_vidc_session_set_codec(inst);
+	if (rc)
+		return rc;
+
+	rc = msm_vidc_session_set_secure_mode(inst);
+	if (rc)
+		return rc;
+
+	if (is_encode_session(inst)) {
+		rc = msm_vidc_alloc_and_queue_session_internal_buffers(inst,
+			MSM_VIDC_BUF_ARP);
+		if (rc)
+			return rc;
+	} else if (is_decode_session(inst)) {
+		rc = msm_vidc_session_set_default_header(inst);
+		if (rc)
+			return rc;
+
+		rc = msm_vidc_alloc_and_queue_session_internal_buffers(inst,
+			MSM_VIDC_BUF_PERSIST);
+		if (rc)
+			return rc;
+	}
+
+	return rc;
+}
+
 int msm_vidc_session_set_codec(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
@@ -5034,11 +5409,12 @@ static void update_inst_capability(struct msm_platform_inst_capability *in,
 
 static void update_inst_cap_dependency(
 	struct msm_platform_inst_cap_dependency *in,
-	struct msm_vidc_inst_capability *capability)
+	struct msm_vidc_inst_capability *capability,
+	struct msm_vidc_inst_cap_dependency *dependency)
 {
-	if (!in || !capability) {
-		d_vpr_e("%s: invalid params %pK %pK\n",
-			__func__, in, capability);
+	if (!in || !capability || !dependency) {
+		d_vpr_e("%s: invalid params %pK %pK %pK\n",
+			__func__, in, capability, dependency);
 		return;
 	}
 	if (in->cap_id >= INST_CAP_MAX) {
@@ -5047,15 +5423,51 @@ static void update_inst_cap_dependency(
 	}
 
 	capability->cap[in->cap_id].cap_id = in->cap_id;
-	memcpy(capability->cap[in->cap_id].parents, in->parents,
-		sizeof(capability->cap[in->cap_id].parents));
-	memcpy(capability->cap[in->cap_id].children, in->children,
-		sizeof(capability->cap[in->cap_id].children));
-	capability->cap[in->cap_id].adjust = in->adjust;
-	capability->cap[in->cap_id].set = in->set;
+	memcpy(dependency[in->cap_id].parents, in->parents,
+		sizeof(dependency[in->cap_id].parents));
+	memcpy(dependency[in->cap_id].children, in->children,
+		sizeof(dependency[in->cap_id].children));
+	dependency[in->cap_id].adjust = in->adjust;
+	dependency[in->cap_id].set = in->set;
 }
 
-int msm_vidc_deinit_instance_caps(struct msm_vidc_core *core)
+static int cap_v4l2_map_cmp(const void *a, const void *b)
+{
+	const struct msm_vidc_cap_v4l2_map *l = a, *r = b;
+
+	if (l->v4l2_id != r->v4l2_id)
+		return l->v4l2_id < r->v4l2_id ? -1 : 1;
+
+	return l->cap_id < r->cap_id ? -1 : (l->cap_id > r->cap_id);
+}
+
+static void update_inst_cap_v4l2_map(struct msm_vidc_inst_capability *capability,
+	struct msm_vidc_cap_v4l2_map *map)
+{
+	u32 i, count = 0, unique = 0;
+
+	for (i = INST_CAP_NONE + 1; i < INST_CAP_MAX; i++) {
+		if (!capability->cap[i].v4l2_id)
+			continue;
+
+		map[count].v4l2_id = capability->cap[i].v4l2_id;
+		map[count].cap_id = capability->cap[i].cap_id;
+		count++;
+	}
+	sort(map, count, sizeof(*map), cap_v4l2_map_cmp, NULL);
+
+	/* keep lowest cap id for a shared v4l2 id, same as a linear scan */
+	for (i = 0; i < count; i++) {
+		if (unique && map[unique - 1].v4l2_id == map[i].v4l2_id)
+			continue;
+		map[unique++] = map[i];
+	}
+
+	capability->v4l2_map = map;
+	capability->v4l2_map_count = unique;
+}
+
+int msm_vidc_deinit_instance_caps(struct msm_vidc_core *core)
 {
 	int rc = 0;
 
@@ -5066,6 +5478,12 @@ int msm_vidc_deinit_instance_caps(struct msm_vidc_core *core)
 
 	msm_vidc_vmem_free((void **)&core->inst_caps);
 	core->inst_caps = NULL;
+	msm_vidc_vmem_free((void **)&core->inst_cap_dependency);
+	core->inst_cap_dependency = NULL;
+	msm_vidc_vmem_free((void **)&core->inst_cap_order);
+	core->inst_cap_order = NULL;
+	msm_vidc_vmem_free((void **)&core->inst_cap_v4l2_map);
+	core->inst_cap_v4l2_map = NULL;
 	d_vpr_h("%s: core->inst_caps freed\n", __func__);
 
 	return rc;
@@ -5119,6 +5537,28 @@ int msm_vidc_init_instance_caps(struct msm_vidc_core *core)
 	if (rc)
 		goto error;
 
+	/* dependency graph and callbacks are shared by all instances */
+	rc = msm_vidc_vmem_alloc(codecs_count * (INST_CAP_MAX + 1) *
+		sizeof(struct msm_vidc_inst_cap_dependency),
+		(void **)&core->inst_cap_dependency, __func__);
+	if (rc)
+		goto error;
+	for (i = 0; i < codecs_count; i++)
+		core->inst_caps[i].dependency =
+			&core->inst_cap_dependency[i * (INST_CAP_MAX + 1)];
+
+	rc = msm_vidc_vmem_alloc(codecs_count * INST_CAP_MAX *
+		sizeof(enum msm_vidc_inst_capability_type),
+		(void **)&core->inst_cap_order, __func__);
+	if (rc)
+		goto error;
+
+	rc = msm_vidc_vmem_alloc(codecs_count * INST_CAP_MAX *
+		sizeof(struct msm_vidc_cap_v4l2_map),
+		(void **)&core->inst_cap_v4l2_map, __func__);
+	if (rc)
+		goto error;
+
 	check_bit = 0;
 	/* determine codecs for enc domain */
 	for (i = 0; i < enc_codec_count; i++) {
@@ -5181,11 +5621,39 @@ int msm_vidc_init_instance_caps(struct msm_vidc_core *core)
 				/* update core dependency capability */
 				update_inst_cap_dependency(
 					&platform_cap_dependency_data[i],
-					&core->inst_caps[j]);
+					&core->inst_caps[j],
+					&core->inst_cap_dependency[j * (INST_CAP_MAX + 1)]);
 			}
 		}
 	}
 
+	/* build v4l2_id to cap_id index used on the s_ctrl path */
+	for (j = 0; j < codecs_count; j++)
+		update_inst_cap_v4l2_map(&core->inst_caps[j],
+			&core->inst_cap_v4l2_map[j * INST_CAP_MAX]);
+
+	/*
+	 * prepare adjust/set order once per codec. On a dependency loop only
+	 * sessions of that codec fail, order count stays zero for them.
+	 */
+	for (j = 0; j < codecs_count; j++) {
+		rc = msm_vidc_prepare_dependency_list(&core->inst_caps[j],
+			&core->inst_cap_order[j * INST_CAP_MAX],
+			&core->inst_caps[j].dependency_order_count);
+		if (rc) {
+			d_vpr_e("%s: dependency order failed for codec %#x domain %#x\n",
+				__func__, core->inst_caps[j].codec,
+				core->inst_caps[j].domain);
+			rc = 0;
+			continue;
+		}
+		core->inst_caps[j].dependency_order =
+			&core->inst_cap_order[j * INST_CAP_MAX];
+		d_vpr_h("%s: codec %#x domain %#x, %u caps in dependency order\n",
+			__func__, core->inst_caps[j].codec, core->inst_caps[j].domain,
+			core->inst_caps[j].dependency_order_count);
+	}
+
 error:
 	return rc;
 }
@@ -5225,6 +5693,9 @@ int msm_vidc_core_deinit_locked(struct msm_vidc_core *core, bool force)
 
 	/* unlink all sessions from core, if any */
 	list_for_each_entry_safe(inst, dummy, &core->instances, list) {
+		/* kept on the core, reopened once fw is back */
+		if (inst->recovery_pending)
+			continue;
 		msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
 		list_del_init(&inst->list);
 		list_add_tail(&inst->list, &core->dangling_instances);
@@ -5621,7 +6092,7 @@ int msm_vidc_trigger_stability(struct msm_vidc_core *core,
 	core_lock(core, __func__);
 	list_for_each_entry(inst, &core->instances, list) {
 		memcpy(&inst->stability, &stability, sizeof(struct msm_vidc_stability));
-		schedule_work(&inst->stability_work);
+		queue_work(core->inst_workq, &inst->stability_work);
 	}
 	core_unlock(core, __func__);
 
@@ -5635,7 +6106,7 @@ void msm_vidc_stability_handler(struct work_struct *work)
 	struct msm_vidc_stability *stability;
 
 	inst = container_of(work, struct msm_vidc_inst, stability_work);
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_any(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
@@ -5663,6 +6134,304 @@ int cancel_stability_work_sync(struct msm_vidc_inst *inst)
 	return 0;
 }
 
+/*
+ * cmdq backlog drain runs under core lock and cannot take the instance
+ * lock, so a packet it failed to write fails the session from here
+ */
+void msm_vidc_cmdq_error_handler(struct work_struct *work)
+{
+	struct msm_vidc_inst *inst;
+
+	inst = container_of(work, struct msm_vidc_inst, cmdq_error_work);
+	inst = get_inst_ref_any(inst);
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	inst_lock(inst, __func__);
+	i_vpr_e(inst, "%s: deferred command lost, session in error\n", __func__);
+	msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
+	inst_unlock(inst, __func__);
+
+	put_inst(inst);
+}
+
+/* caller holds inst lock, cmdq backlog reads the class under core lock */
+int msm_vidc_update_cmdq_class(struct msm_vidc_inst *inst)
+{
+	bool realtime;
+
+	if (!inst || !inst->core || !inst->capabilities) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	realtime = is_realtime_session(inst);
+	core_lock(inst->core, __func__);
+	inst->cmdq_realtime = realtime;
+	core_unlock(inst->core, __func__);
+
+	return 0;
+}
+
+static bool msm_vidc_allow_recovery(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	if (!core->capabilities[SESSION_RECOVERY].value)
+		return false;
+	if (is_session_error(inst) || !inst->packet)
+		return false;
+	/* fw side of drain and resolution change can not be replayed */
+	if (is_sub_state(inst, MSM_VIDC_DRAIN) ||
+		is_sub_state(inst, MSM_VIDC_DRC) ||
+		is_sub_state(inst, MSM_VIDC_DRAIN_LAST_BUFFER) ||
+		is_sub_state(inst, MSM_VIDC_DRC_LAST_BUFFER))
+		return false;
+
+	return true;
+}
+
+/*
+ * Fatal fw error: tear the core down, but keep recoverable sessions on the
+ * core so that recovery_work can reopen them once fw is booted again.
+ * Without SESSION_RECOVERY this is a plain forced core deinit.
+ */
+int msm_vidc_core_recover(struct msm_vidc_core *core)
+{
+	struct msm_vidc_inst *inst;
+	bool recover = false;
+	int rc = 0;
+
+	if (!core || !core->capabilities) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	core_lock(core, __func__);
+	list_for_each_entry(inst, &core->instances, list) {
+		inst->recovery_pending = msm_vidc_allow_recovery(inst);
+		recover |= inst->recovery_pending;
+	}
+	rc = msm_vidc_core_deinit_locked(core, true);
+	core_unlock(core, __func__);
+
+	if (recover) {
+		d_vpr_h("%s: core%u scheduling session recovery\n", __func__, core->id);
+		queue_work(core->inst_workq, &core->recovery_work);
+	}
+
+	return rc;
+}
+
+/* fw lost everything it held, bring the host side back to a pre-streamon view */
+static void msm_vidc_recovery_reset_buffers(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_buffers *buffers;
+	struct msm_vidc_buffer *buf, *dummy;
+	static const enum msm_vidc_buffer_type ext_buf_types[] = {
+		MSM_VIDC_BUF_INPUT,
+		MSM_VIDC_BUF_OUTPUT,
+		MSM_VIDC_BUF_INPUT_META,
+		MSM_VIDC_BUF_OUTPUT_META,
+	};
+	static const enum msm_vidc_buffer_type internal_buf_types[] = {
+		MSM_VIDC_BUF_BIN,
+		MSM_VIDC_BUF_ARP,
+		MSM_VIDC_BUF_COMV,
+		MSM_VIDC_BUF_NON_COMV,
+		MSM_VIDC_BUF_LINE,
+		MSM_VIDC_BUF_DPB,
+		MSM_VIDC_BUF_PERSIST,
+		MSM_VIDC_BUF_VPSS,
+		MSM_VIDC_BUF_PARTIAL_DATA,
+	};
+	int i;
+
+	/* buffers owned by fw are queued again after streamon replay */
+	for (i = 0; i < ARRAY_SIZE(ext_buf_types); i++) {
+		buffers = msm_vidc_get_buffers(inst, ext_buf_types[i], __func__);
+		if (!buffers)
+			continue;
+		list_for_each_entry(buf, &buffers->list, list) {
+			buf->attr &= ~MSM_VIDC_ATTR_READ_ONLY;
+			if (!(buf->attr & MSM_VIDC_ATTR_QUEUED) ||
+				buf->attr & MSM_VIDC_ATTR_BUFFER_DONE)
+				continue;
+			buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
+			buf->attr |= MSM_VIDC_ATTR_DEFERRED;
+		}
+	}
+
+	/* no references or releases are pending with the new fw */
+	list_for_each_entry_safe(buf, dummy, &inst->buffers.read_only.list, list) {
+		list_del(&buf->list);
+		msm_memory_pool_free(inst, buf);
+	}
+	list_for_each_entry_safe(buf, dummy, &inst->buffers.release.list, list) {
+		list_del(&buf->list);
+		msm_memory_pool_free(inst, buf);
+	}
+
+	/* internal buffers are sized and allocated again on streamon */
+	for (i = 0; i < ARRAY_SIZE(internal_buf_types); i++) {
+		buffers = msm_vidc_get_buffers(inst, internal_buf_types[i], __func__);
+		if (!buffers)
+			continue;
+		list_for_each_entry_safe(buf, dummy, &buffers->list, list)
+			msm_vidc_destroy_internal_buffer(inst, buf);
+		buffers->size = 0;
+		buffers->min_count = 0;
+		buffers->reuse = false;
+	}
+
+	msm_vidc_flush_ts(inst);
+	if (is_ts_reorder_allowed(inst))
+		msm_vidc_ts_reorder_flush(inst);
+}
+
+static int msm_vidc_session_recover(struct msm_vidc_inst *inst)
+{
+	struct v4l2_event event = {0};
+	bool input, output;
+	int rc = 0;
+
+	if (is_session_error(inst))
+		return -EINVAL;
+
+	input = is_state(inst, MSM_VIDC_INPUT_STREAMING) ||
+		is_state(inst, MSM_VIDC_STREAMING);
+	output = is_state(inst, MSM_VIDC_OUTPUT_STREAMING) ||
+		is_state(inst, MSM_VIDC_STREAMING);
+
+	msm_vidc_recovery_reset_buffers(inst);
+	inst->once_per_session_set = false;
+	inst->ipsc_properties_set = false;
+	inst->opsc_properties_set = false;
+	inst->state = MSM_VIDC_OPEN;
+	inst->sub_state = MSM_VIDC_SUB_STATE_NONE;
+	strlcpy(inst->sub_state_name, "SUB_STATE_NONE", sizeof(inst->sub_state_name));
+
+	rc = venus_hfi_session_open(inst);
+	if (rc)
+		return rc;
+
+	/* replay streamon, which sets caps and internal buffers again */
+	if (input || output) {
+		rc = msm_vidc_session_streamon_prepare(inst);
+		if (rc)
+			return rc;
+		msm_vidc_power_data_reset(inst);
+	}
+
+	if (input) {
+		if (is_decode_session(inst))
+			rc = msm_vdec_streamon_input(inst);
+		else
+			rc = msm_venc_streamon_input(inst);
+		if (rc)
+			return rc;
+	}
+
+	if (output) {
+		if (is_decode_session(inst))
+			rc = msm_vdec_streamon_output(inst);
+		else
+			rc = msm_venc_streamon_output(inst);
+		if (rc)
+			return rc;
+	}
+
+	if (input) {
+		rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_INPUT);
+		if (rc)
+			return rc;
+	}
+
+	if (output) {
+		rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_OUTPUT);
+		if (rc)
+			return rc;
+	}
+
+	if (input && output) {
+		rc = msm_vidc_get_properties(inst);
+		if (rc)
+			return rc;
+	}
+
+	inst->recovery_count++;
+	event.type = V4L2_EVENT_VIDC_RECOVERED;
+	v4l2_event_queue_fh(&inst->event_handler, &event);
+
+	return 0;
+}
+
+static struct msm_vidc_inst *msm_vidc_get_recovery_inst(struct msm_vidc_core *core)
+{
+	struct msm_vidc_inst *inst;
+
+	core_lock(core, __func__);
+	list_for_each_entry(inst, &core->instances, list) {
+		if (inst->recovery_pending && kref_get_unless_zero(&inst->kref)) {
+			core_unlock(core, __func__);
+			return inst;
+		}
+	}
+	core_unlock(core, __func__);
+
+	return NULL;
+}
+
+void msm_vidc_recovery_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+	struct msm_vidc_inst *inst;
+	int rc = 0, core_rc;
+
+	core = container_of(work, struct msm_vidc_core, recovery_work);
+
+	core_rc = msm_vidc_core_init(core);
+	if (!core_rc)
+		core_rc = msm_vidc_core_init_wait(core);
+	if (core_rc)
+		d_vpr_e("%s: core%u reinit failed, sessions not recovered\n",
+			__func__, core->id);
+
+	while ((inst = msm_vidc_get_recovery_inst(core))) {
+		client_lock(inst, __func__);
+		inst_lock(inst, __func__);
+		inst->recovery_pending = false;
+		rc = core_rc;
+		/* client may have moved the session on since the core went down */
+		if (!rc && !msm_vidc_allow_recovery(inst)) {
+			i_vpr_e(inst, "%s: session no longer recoverable, state %s, sub state %s\n",
+				__func__, state_name(inst->state), inst->sub_state_name);
+			rc = -EINVAL;
+		}
+		if (!rc)
+			rc = msm_vidc_session_recover(inst);
+		if (rc) {
+			i_vpr_e(inst, "%s: recovery failed\n", __func__);
+			msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
+		} else {
+			i_vpr_h(inst, "%s: session recovered\n", __func__);
+		}
+		inst_unlock(inst, __func__);
+		client_unlock(inst, __func__);
+
+		/* unrecoverable session is left to the client, as on deinit */
+		if (rc) {
+			core_lock(core, __func__);
+			list_del_init(&inst->list);
+			list_add_tail(&inst->list, &core->dangling_instances);
+			core_unlock(core, __func__);
+		}
+		put_inst(inst);
+	}
+}
+
 void msm_vidc_fw_unload_handler(struct work_struct *work)
 {
 	struct msm_vidc_core *core = NULL;
@@ -5675,10 +6444,99 @@ void msm_vidc_fw_unload_handler(struct work_struct *work)
 	}
 
 	d_vpr_h("%s: deinitializing video core\n",__func__);
-	rc = msm_vidc_core_deinit(core, false);
+	core_lock(core, __func__);
+	rc = msm_vidc_core_deinit_locked(core, false);
 	if (rc)
 		d_vpr_e("%s: Failed to deinit core\n", __func__);
+	if (core->state == MSM_VIDC_CORE_DEINIT) {
+		core->fw_warm.unloads++;
+		core->fw_warm.open_count = 0;
+	}
+	core_unlock(core, __func__);
+}
+
+void msm_vidc_fw_preload_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+	int rc = 0;
 
+	core = container_of(work, struct msm_vidc_core, fw_preload_work);
+
+	/* an open racing with the preload simply waits on the core lock */
+	rc = msm_vidc_core_init(core);
+	if (!rc)
+		rc = msm_vidc_core_init_wait(core);
+	if (rc) {
+		d_vpr_e("%s: core%u fw preload failed, load on first open\n",
+			__func__, core->id);
+		return;
+	}
+
+	core_lock(core, __func__);
+	core->fw_warm.preloads++;
+	core_unlock(core, __func__);
+	d_vpr_h("%s: core%u fw preloaded\n", __func__, core->id);
+}
+
+/* returns true if this open has to load the firmware */
+bool msm_vidc_fw_warm_open(struct msm_vidc_core *core)
+{
+	struct msm_vidc_fw_warm *warm = &core->fw_warm;
+	u32 gap_ms;
+	bool cold;
+
+	core_lock(core, __func__);
+	cold = core->state == MSM_VIDC_CORE_DEINIT;
+	if (list_empty(&core->instances) && warm->last_close_ns) {
+		gap_ms = (u32)min_t(u64, div_u64(ktime_get_ns() - warm->last_close_ns,
+			NSEC_PER_MSEC), U32_MAX);
+		warm->idle_avg_ms = warm->idle_avg_ms ?
+			(warm->idle_avg_ms * 3 + gap_ms) / 4 : gap_ms;
+		warm->last_close_ns = 0;
+	}
+	warm->open_count++;
+	if (cold)
+		warm->cold_opens++;
+	else
+		warm->warm_opens++;
+	core_unlock(core, __func__);
+
+	return cold;
+}
+
+void msm_vidc_fw_warm_ready(struct msm_vidc_core *core, u64 start_ns, bool cold)
+{
+	u64 ready_us = div_u64(ktime_get_ns() - start_ns, NSEC_PER_USEC);
+
+	core->fw_warm.ready_us = (u32)min_t(u64, ready_us, U32_MAX);
+	trace_msm_vidc_open_latency(cold ? "open_cold" : "open_warm",
+		core->id, ready_us);
+}
+
+static u32 msm_vidc_fw_unload_delay(struct msm_vidc_core *core)
+{
+	struct msm_vidc_fw_warm *warm = &core->fw_warm;
+	u32 delay, max_delay;
+
+	delay = core->capabilities[FW_UNLOAD_DELAY].value;
+	max_delay = max_t(u32, core->capabilities[FW_KEEP_WARM_MAX].value, delay);
+
+	switch (core->capabilities[FW_KEEP_WARM].value) {
+	case MSM_VIDC_FW_WARM_USAGE:
+		/* every reuse since the last load doubles the warm period */
+		if (warm->open_count > 1)
+			delay <<= min_t(u32, warm->open_count - 1, 8);
+		break;
+	case MSM_VIDC_FW_WARM_PREDICT:
+		/* keep warm across the expected gap, unless it is too long anyway */
+		if (warm->idle_avg_ms && 2 * warm->idle_avg_ms <= max_delay)
+			delay = max(delay, 2 * warm->idle_avg_ms);
+		break;
+	default:
+		break;
+	}
+
+	return min(delay, max_delay);
 }
 
 int msm_vidc_suspend(struct msm_vidc_core *core)
@@ -5697,6 +6555,141 @@ int msm_vidc_suspend(struct msm_vidc_core *core)
 	return rc;
 }
 
+void msm_vidc_nrt_sched_kick(struct msm_vidc_core *core)
+{
+	u32 quantum = core->capabilities[NRT_SCHED_QUANTUM].value;
+
+	if (quantum && !delayed_work_pending(&core->nrt_sched.work))
+		mod_delayed_work(core->inst_workq, &core->nrt_sched.work,
+			msecs_to_jiffies(quantum));
+}
+
+static bool msm_vidc_nrt_sched_candidate(struct msm_vidc_inst *inst)
+{
+	return is_throughput_session(inst) && is_state(inst, MSM_VIDC_STREAMING) &&
+		!is_sub_state(inst, MSM_VIDC_DRAIN) && !inst->recovery_pending;
+}
+
+/*
+ * Picks, lowest vruntime first, the offline sessions whose nominal load
+ * fits in what realtime sessions leave over; at least one always runs.
+ * The rest get no new input until a later quantum selects them again.
+ */
+void msm_vidc_nrt_sched_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+	struct msm_vidc_inst *inst, *pick, **insts = NULL;
+	struct msm_vidc_nrt_slice *slice;
+	u64 now, delta, load = 0, used = 0, headroom, min_vruntime = U64_MAX;
+	u32 count = 0, num = 0, offline = 0, waiting = 0, i;
+	int rc = 0;
+
+	core = container_of(work, struct msm_vidc_core, nrt_sched.work.work);
+
+	core_lock(core, __func__);
+	now = ktime_get_ns();
+	list_for_each_entry(inst, &core->instances, list) {
+		count++;
+		if (is_throughput_session(inst))
+			offline++;
+		load += max(msm_vidc_get_inst_load(inst), 0);
+		slice = &inst->nrt_slice;
+		slice->selected = false;
+		if (!msm_vidc_nrt_sched_candidate(inst)) {
+			slice->start_ns = 0;
+			continue;
+		}
+		slice->weight = max_t(s32, 1, NRT_PRIORITY_OFFSET + 2 -
+			inst->capabilities->cap[PRIORITY].value);
+		if (!slice->start_ns)
+			continue;
+		if (!slice->paused) {
+			delta = now - slice->start_ns;
+			slice->run_ns += delta;
+			slice->vruntime_ns += div_u64(delta, slice->weight);
+		}
+		min_vruntime = min(min_vruntime, slice->vruntime_ns);
+	}
+
+	/* newcomers start level with the others instead of owning the core */
+	list_for_each_entry(inst, &core->instances, list) {
+		slice = &inst->nrt_slice;
+		if (msm_vidc_nrt_sched_candidate(inst) && !slice->start_ns)
+			slice->vruntime_ns = min_vruntime == U64_MAX ? 0 : min_vruntime;
+	}
+
+	headroom = core->capabilities[MAX_MBPS].value > load ?
+		core->capabilities[MAX_MBPS].value - load : 0;
+	while (1) {
+		pick = NULL;
+		list_for_each_entry(inst, &core->instances, list) {
+			if (!msm_vidc_nrt_sched_candidate(inst) || inst->nrt_slice.selected)
+				continue;
+			if (!pick || inst->nrt_slice.vruntime_ns < pick->nrt_slice.vruntime_ns)
+				pick = inst;
+		}
+		if (!pick || (used && used + msm_vidc_get_mbps(pick) > headroom))
+			break;
+		pick->nrt_slice.selected = true;
+		used += msm_vidc_get_mbps(pick);
+	}
+
+	if (count && msm_vidc_vmem_alloc(count * sizeof(*insts),
+			(void **)&insts, __func__))
+		insts = NULL;
+	list_for_each_entry(inst, &core->instances, list) {
+		slice = &inst->nrt_slice;
+		if (msm_vidc_nrt_sched_candidate(inst)) {
+			slice->start_ns = now;
+			if (slice->selected)
+				slice->slices++;
+			else
+				waiting++;
+		} else if (!slice->paused) {
+			continue;
+		}
+		/* paused is applied under the instance lock below */
+		if (insts && kref_get_unless_zero(&inst->kref))
+			insts[num++] = inst;
+	}
+	core->nrt_sched.rounds++;
+	core->nrt_sched.waiting = waiting;
+	if (waiting)
+		core->nrt_sched.sliced_rounds++;
+	core_unlock(core, __func__);
+
+	for (i = 0; i < num; i++) {
+		inst = insts[i];
+		slice = &inst->nrt_slice;
+		inst_lock(inst, __func__);
+		/* session may have drained or stopped since the pick */
+		if (msm_vidc_nrt_sched_candidate(inst) && !slice->selected) {
+			if (!slice->paused)
+				slice->preempts++;
+			slice->paused = true;
+		} else if (slice->paused) {
+			/* selected, or no longer scheduled at all: let input flow again */
+			slice->paused = false;
+			if (!is_session_error(inst) &&
+				msm_vidc_allow_qbuf(inst, INPUT_MPLANE) == MSM_VIDC_ALLOW) {
+				rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_INPUT);
+				if (rc) {
+					i_vpr_e(inst, "%s: resume qbufs failed\n", __func__);
+					msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
+				}
+			}
+		}
+		inst_unlock(inst, __func__);
+		put_inst(inst);
+	}
+	msm_vidc_vmem_free((void **)&insts);
+
+	/* no offline session left, stay idle until the next one streams on */
+	if (offline)
+		mod_delayed_work(core->inst_workq, &core->nrt_sched.work,
+			msecs_to_jiffies(core->capabilities[NRT_SCHED_QUANTUM].value));
+}
+
 void msm_vidc_batch_handler(struct work_struct *work)
 {
 	struct msm_vidc_inst *inst;
@@ -5705,7 +6698,7 @@ void msm_vidc_batch_handler(struct work_struct *work)
 	int rc = 0;
 
 	inst = container_of(work, struct msm_vidc_inst, decode_batch.work.work);
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_any(inst);
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
@@ -5731,6 +6724,7 @@ void msm_vidc_batch_handler(struct work_struct *work)
 	}
 
 	i_vpr_h(inst, "%s: queue pending batch buffers\n", __func__);
+	inst->decode_batch.timeout_count++;
 	rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_OUTPUT);
 	if (rc) {
 		i_vpr_e(inst, "%s: batch qbufs failed\n", __func__);
@@ -5742,6 +6736,42 @@ exit:
 	put_inst(inst);
 }
 
+void msm_vidc_encode_batch_handler(struct work_struct *work)
+{
+	struct msm_vidc_inst *inst;
+	struct msm_vidc_core *core;
+	int rc = 0;
+
+	inst = container_of(work, struct msm_vidc_inst, encode_batch.work.work);
+	inst = get_inst_ref_any(inst);
+	if (!inst || !inst->core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	core = inst->core;
+	inst_lock(inst, __func__);
+	if (is_session_error(inst)) {
+		i_vpr_e(inst, "%s: failled. Session error\n", __func__);
+		goto exit;
+	}
+
+	if (core->pm_suspended) {
+		i_vpr_h(inst, "%s: device in pm suspend state\n", __func__);
+		goto exit;
+	}
+
+	i_vpr_l(inst, "%s: queue pending batch buffers\n", __func__);
+	inst->encode_batch.timeout_count++;
+	rc = msm_vidc_flush_encode_batch(inst);
+	if (rc)
+		msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
+
+exit:
+	inst_unlock(inst, __func__);
+	put_inst(inst);
+}
+
 int msm_vidc_flush_buffers(struct msm_vidc_inst *inst,
 		enum msm_vidc_buffer_type type)
 {
@@ -5976,11 +7006,6 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 		msm_vidc_vmem_free((void **)&entry);
 	}
 
-	list_for_each_entry_safe(entry, dummy_entry, &inst->caps_list, list) {
-		list_del(&entry->list);
-		msm_vidc_vmem_free((void **)&entry);
-	}
-
 	list_for_each_entry_safe(fence, dummy_fence, &inst->fence_list, list) {
 		i_vpr_e(inst, "%s: destroying fence %s\n", __func__, fence->name);
 		msm_vidc_fence_destroy(inst, (u32)fence->dma_fence.seqno);
@@ -6005,8 +7030,6 @@ static void msm_vidc_close_helper(struct kref *kref)
 	else if (is_encode_session(inst))
 		msm_venc_inst_deinit(inst);
 	msm_vidc_free_input_cr_list(inst);
-	if (inst->workq)
-		destroy_workqueue(inst->workq);
 	msm_vidc_remove_dangling_session(inst);
 	mutex_destroy(&inst->client_lock);
 	mutex_destroy(&inst->request_lock);
@@ -6038,6 +7061,196 @@ struct msm_vidc_inst *get_inst_ref(struct msm_vidc_core *core,
 	return inst;
 }
 
+/*
+ * v4l2 and vb2 entry points already hold the instance through its file,
+ * so it is validated against its own core only, no cross-core walk.
+ */
+struct msm_vidc_inst *get_inst_ref_self(struct msm_vidc_inst *instance)
+{
+	if (!instance || !instance->core)
+		return NULL;
+
+	return get_inst_ref(instance->core, instance);
+}
+
+/*
+ * work handlers may run after their instance was freed, so the instance
+ * is only compared against each registered core's list, never dereferenced
+ */
+struct msm_vidc_inst *get_inst_ref_any(struct msm_vidc_inst *instance)
+{
+	struct msm_vidc_core *core;
+	struct msm_vidc_inst *inst = NULL;
+
+	if (!instance)
+		return NULL;
+
+	mutex_lock(&msm_vidc_cores_lock);
+	list_for_each_entry(core, &msm_vidc_cores, list) {
+		inst = get_inst_ref(core, instance);
+		if (inst)
+			break;
+	}
+	mutex_unlock(&msm_vidc_cores_lock);
+
+	return inst;
+}
+
+int msm_vidc_alloc_core_id(struct msm_vidc_core *core)
+{
+	int id;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	/* lowest free id, reused once its core is removed */
+	id = ida_alloc(&msm_vidc_core_ida, GFP_KERNEL);
+	if (id < 0) {
+		d_vpr_e("%s: no core id available %d\n", __func__, id);
+		return id;
+	}
+	core->id = id;
+	INIT_LIST_HEAD(&core->list);
+
+	return 0;
+}
+
+void msm_vidc_free_core_id(struct msm_vidc_core *core)
+{
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	ida_free(&msm_vidc_core_ida, core->id);
+}
+
+/* called once probe and component bind fully succeeded */
+void msm_vidc_register_core(struct msm_vidc_core *core)
+{
+	struct msm_vidc_core *entry;
+	struct list_head *pos;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	/* keep the list sorted by id */
+	mutex_lock(&msm_vidc_cores_lock);
+	pos = &msm_vidc_cores;
+	list_for_each_entry(entry, &msm_vidc_cores, list) {
+		if (entry->id > core->id) {
+			pos = &entry->list;
+			break;
+		}
+	}
+	if (list_empty(&core->list))
+		list_add_tail(&core->list, pos);
+	mutex_unlock(&msm_vidc_cores_lock);
+
+	d_vpr_h("%s: registered core%u\n", __func__, core->id);
+}
+
+/* first step of teardown, safe on a core that never got registered */
+void msm_vidc_unregister_core(struct msm_vidc_core *core)
+{
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	mutex_lock(&msm_vidc_cores_lock);
+	list_del_init(&core->list);
+	mutex_unlock(&msm_vidc_cores_lock);
+
+	d_vpr_h("%s: unregistered core%u\n", __func__, core->id);
+}
+
+struct workqueue_struct *msm_vidc_create_workqueue(const char *name)
+{
+	unsigned int flags = WQ_MEM_RECLAIM;
+
+	if (msm_vidc_workq_highpri)
+		flags |= WQ_HIGHPRI;
+
+	return alloc_ordered_workqueue("%s", flags, name);
+}
+
+int msm_vidc_set_irq_affinity(struct msm_vidc_core *core,
+	const struct cpumask *mask)
+{
+	int rc = 0;
+
+	if (!core || !core->dt || !mask) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!cpumask_empty(mask) && !cpumask_intersects(mask, cpu_online_mask)) {
+		d_vpr_e("%s: no online cpu in %*pbl\n",
+			__func__, cpumask_pr_args(mask));
+		return -EINVAL;
+	}
+
+	/* empty mask drops the hint and leaves placement to the irq core */
+	if (core->dt->irq) {
+		rc = irq_set_affinity_hint(core->dt->irq,
+			cpumask_empty(mask) ? NULL : mask);
+		if (rc) {
+			d_vpr_e("%s: failed to set irq affinity, %d\n", __func__, rc);
+			return rc;
+		}
+	}
+	cpumask_copy(&core->irq_cpus, mask);
+	d_vpr_h("%s: core%u irq cpus %*pbl\n",
+		__func__, core->id, cpumask_pr_args(&core->irq_cpus));
+
+	return rc;
+}
+
+int msm_vidc_set_irq_sched(struct msm_vidc_core *core, u32 sched)
+{
+	if (!core || sched >= MSM_VIDC_IRQ_SCHED_MAX) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	/* applied by the isr thread itself on its next run */
+	core->irq_sched = sched;
+	core->irq_sched_update = true;
+
+	return 0;
+}
+
+u64 msm_vidc_get_core_load(struct msm_vidc_core *core, u32 *count)
+{
+	struct msm_vidc_inst *inst;
+	u64 load = 0;
+	u32 num = 0;
+	int inst_load;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return 0;
+	}
+
+	core_lock(core, __func__);
+	list_for_each_entry(inst, &core->instances, list) {
+		num++;
+		inst_load = msm_vidc_get_inst_load(inst);
+		if (inst_load > 0)
+			load += inst_load;
+	}
+	core_unlock(core, __func__);
+
+	if (count)
+		*count = num;
+	return load;
+}
+
 struct msm_vidc_inst *get_inst(struct msm_vidc_core *core,
 		u32 session_id)
 {
@@ -6251,19 +7464,25 @@ int msm_vidc_update_buffer_count(struct msm_vidc_inst *inst, u32 port)
 
 void msm_vidc_schedule_core_deinit(struct msm_vidc_core *core)
 {
+	u32 delay;
+
 	if (!core)
 		return;
 
+	core_lock(core, __func__);
+	if (list_empty(&core->instances))
+		core->fw_warm.last_close_ns = ktime_get_ns();
+	delay = msm_vidc_fw_unload_delay(core);
+	core_unlock(core, __func__);
+
 	if (!core->capabilities[FW_UNLOAD].value)
 		return;
 
 	cancel_delayed_work(&core->fw_unload_work);
 
-	schedule_delayed_work(&core->fw_unload_work,
-		msecs_to_jiffies(core->capabilities[FW_UNLOAD_DELAY].value));
+	schedule_delayed_work(&core->fw_unload_work, msecs_to_jiffies(delay));
 
-	d_vpr_h("firmware unload delayed by %u ms\n",
-		core->capabilities[FW_UNLOAD_DELAY].value);
+	d_vpr_h("firmware unload delayed by %u ms\n", delay);
 
 	return;
 }
@@ -6391,6 +7610,31 @@ int msm_vidc_check_core_mbps(struct msm_vidc_inst *inst)
 	}
 	core = inst->core;
 
+	/*
+	 * offline sessions are not admitted on their nominal fps, only on
+	 * whether realtime sessions leave room for at least a frame per second
+	 */
+	if (is_throughput_session(inst)) {
+		mbps = msm_vidc_get_core_load(core, NULL);
+		total_mbps = core->capabilities[MAX_MBPS].value > mbps ?
+			core->capabilities[MAX_MBPS].value - mbps : 0;
+		/* oversubscription is time sliced instead of rejected */
+		if (core->capabilities[NRT_SCHED_QUANTUM].value) {
+			i_vpr_h(inst, "%s: throughput session, headroom %u mbps, time sliced\n",
+				__func__, total_mbps);
+			msm_vidc_nrt_sched_kick(core);
+			return 0;
+		}
+		if (total_mbps < msm_vidc_get_mbs_per_frame(inst)) {
+			i_vpr_e(inst, "%s: no headroom left by realtime sessions. rt %u, max %u\n",
+				__func__, mbps, core->capabilities[MAX_MBPS].value);
+			return -ENOMEM;
+		}
+		i_vpr_h(inst, "%s: throughput session, headroom %u mbps\n",
+			__func__, total_mbps);
+		return 0;
+	}
+
 	/* skip mbps check for non-realtime, thumnail, image sessions */
 	if (msm_vidc_ignore_session_load(inst)) {
 		i_vpr_h(inst,
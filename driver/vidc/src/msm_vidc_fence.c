@@ -7,8 +7,6 @@
 #include "msm_vidc_debug.h"
 #include "msm_vidc_driver.h"
 
-extern struct msm_vidc_core *g_core;
-
 static const char *msm_vidc_dma_fence_get_driver_name(struct dma_fence *df)
 {
 	struct msm_vidc_fence *fence;
@@ -4,6 +4,7 @@
  * Copyright (c) 2022 Qualcomm Innovation Center, Inc. All rights reserved.
  */
 
+#include <linux/thermal.h>
 #include "msm_vidc_power.h"
 #include "msm_vidc_debug.h"
 #include "msm_vidc_internal.h"
@@ -14,6 +15,7 @@
 #include "msm_vidc_platform.h"
 #include "msm_vidc_buffer.h"
 #include "venus_hfi.h"
+#include "hfi_packet.h"
 #include "msm_vidc_events.h"
 
 /* Q16 Format */
@@ -137,8 +139,9 @@ static int msm_vidc_set_buses(struct msm_vidc_inst* inst)
 	int rc = 0;
 	struct msm_vidc_core* core;
 	struct msm_vidc_inst* temp;
-	u64 total_bw_ddr = 0, total_bw_llcc = 0;
+	u64 total_bw_ddr = 0, total_bw_llcc = 0, ddr_saved = 0;
 	u64 curr_time_ns;
+	bool sys_cache, turbo = false;
 
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -159,16 +162,31 @@ static int msm_vidc_set_buses(struct msm_vidc_inst* inst)
 			continue;
 		}
 
-		if (temp->power.power_mode == VIDC_POWER_TURBO) {
-			total_bw_ddr = total_bw_llcc = INT_MAX;
-			break;
-		}
+		/* keep summing the saving, turbo only pins the bus vote */
+		ddr_saved += temp->power.ddr_saved;
+		if (temp->power.power_mode == VIDC_POWER_TURBO)
+			turbo = true;
 
 		total_bw_ddr += temp->power.ddr_bw;
 		total_bw_llcc += temp->power.sys_cache_bw;
 	}
+	if (turbo)
+		total_bw_ddr = total_bw_llcc = INT_MAX;
+	/* hold llcc only while the mix saves enough ddr, with hysteresis */
+	core->sys_cache.ddr_saved = ddr_saved;
+	sys_cache = core->sys_cache.enable;
+	if (ddr_saved >= core->capabilities[LLCC_MIN_DDR_SAVING].value)
+		sys_cache = true;
+	else if (ddr_saved < core->capabilities[LLCC_MIN_DDR_SAVING].value / 2)
+		sys_cache = false;
 	mutex_unlock(&core->lock);
 
+	if (sys_cache != core->sys_cache.enable) {
+		rc = venus_hfi_set_sys_cache(inst, sys_cache);
+		if (rc)
+			i_vpr_e(inst, "%s: llcc policy update failed\n", __func__);
+	}
+
 	if (msm_vidc_ddr_bw) {
 		d_vpr_l("msm_vidc_ddr_bw %d\n", msm_vidc_ddr_bw);
 		total_bw_ddr = msm_vidc_ddr_bw;
@@ -194,7 +212,7 @@ int msm_vidc_scale_buses(struct msm_vidc_inst *inst)
 	struct v4l2_format *out_f;
 	struct v4l2_format *inp_f;
 	int codec = 0;
-	u32 operating_rate, frame_rate;
+	u32 operating_rate, frame_rate, other_ddr = 0;
 
 	if (!inst || !inst->core || !inst->capabilities) {
 		d_vpr_e("%s: invalid params: %pK\n", __func__, inst);
@@ -240,6 +258,9 @@ int msm_vidc_scale_buses(struct msm_vidc_inst *inst)
 		vote_data->lcu_size =
 			inst->capabilities->cap[SUPER_BLOCK].value ? 128 : 64;
 	vote_data->fps = inst->max_rate;
+	/* offline sessions move data at the rate they actually achieve */
+	if (is_throughput_session(inst))
+		vote_data->fps = max(vote_data->fps, inst->throughput.fps);
 
 	if (inst->domain == MSM_VIDC_ENCODER) {
 		vote_data->domain = MSM_VIDC_ENCODER;
@@ -293,15 +314,30 @@ int msm_vidc_scale_buses(struct msm_vidc_inst *inst)
 		}
 	}
 	vote_data->work_mode = inst->capabilities->cap[STAGE].value;
-	if (core->dt->sys_cache_res_set)
-		vote_data->use_sys_cache = true;
 	vote_data->num_vpp_pipes = core->capabilities[NUM_VPP_PIPE].value;
 	fill_dynamic_stats(inst, vote_data);
 
+	/*
+	 * run the bus model the other way first to learn what llcc is worth
+	 * to this session, then for real so vote_data ends up current.
+	 */
+	if (core->dt->sys_cache_present) {
+		vote_data->use_sys_cache = !core->dt->sys_cache_res_set;
+		call_session_op(core, calc_bw, inst, vote_data);
+		other_ddr = vote_data->calc_bw_ddr;
+	}
+	vote_data->use_sys_cache = core->dt->sys_cache_res_set;
 	call_session_op(core, calc_bw, inst, vote_data);
 
 	inst->power.ddr_bw = vote_data->calc_bw_ddr;
 	inst->power.sys_cache_bw = vote_data->calc_bw_llcc;
+	inst->power.ddr_saved = 0;
+	if (core->dt->sys_cache_present) {
+		if (core->dt->sys_cache_res_set && other_ddr > vote_data->calc_bw_ddr)
+			inst->power.ddr_saved = other_ddr - vote_data->calc_bw_ddr;
+		else if (!core->dt->sys_cache_res_set && vote_data->calc_bw_ddr > other_ddr)
+			inst->power.ddr_saved = vote_data->calc_bw_ddr - other_ddr;
+	}
 
 set_buses:
 	inst->power.power_mode = vote_data->power_mode;
@@ -312,16 +348,123 @@ set_buses:
 	return 0;
 }
 
+static bool msm_vidc_sheddable(struct msm_vidc_inst *inst)
+{
+	return is_realtime_session(inst) && !is_critical_priority_session(inst) &&
+		!is_thumbnail_session(inst) && !is_image_session(inst) &&
+		inst->active && inst->max_input_data_size;
+}
+
+/* decoders go first as on mbps overload, then the heaviest session */
+static bool msm_vidc_shed_before(struct msm_vidc_inst *a, struct msm_vidc_inst *b)
+{
+	if (is_decode_session(a) != is_decode_session(b))
+		return is_decode_session(a);
+
+	return a->power.min_freq > b->power.min_freq;
+}
+
+/*
+ * Called with core lock held. Picks just enough unprotected realtime
+ * sessions to cover the shortfall; each applies its own target on its
+ * next power scaling under its own lock.
+ */
+static void msm_vidc_select_shed_sessions(struct msm_vidc_core *core,
+	u64 demand, u64 capacity)
+{
+	struct msm_vidc_inst *inst, *pick;
+	u64 shed = 0;
+
+	core->load_shed.demand = demand;
+	core->load_shed.capacity = capacity;
+
+	/* release only once demand is clearly back under capacity */
+	if (demand * 10 <= capacity * 9) {
+		list_for_each_entry(inst, &core->instances, list)
+			inst->shed.target = 0;
+		return;
+	}
+	if (demand <= capacity)
+		return;
+
+	list_for_each_entry(inst, &core->instances, list) {
+		if (inst->shed.target)
+			shed += inst->power.min_freq;
+	}
+	if (demand - shed > capacity)
+		core->load_shed.overload_count++;
+
+	while (demand - min(shed, demand) > capacity) {
+		pick = NULL;
+		list_for_each_entry(inst, &core->instances, list) {
+			if (inst->shed.target || !msm_vidc_sheddable(inst))
+				continue;
+			if (!pick || msm_vidc_shed_before(inst, pick))
+				pick = inst;
+		}
+		/* only protected sessions left, they keep their deadlines */
+		if (!pick)
+			break;
+		pick->shed.target = 1;
+		shed += pick->power.min_freq;
+	}
+}
+
+static int msm_vidc_apply_shed(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct v4l2_event event = {0};
+	u32 *data = (u32 *)event.u.data;
+	u32 hfi_value;
+	int rc = 0;
+
+	/* a shed session trails every unshed realtime session in firmware */
+	hfi_value = inst->capabilities->cap[PRIORITY].value + inst->shed.target;
+	if (!is_critical_priority_session(inst))
+		hfi_value += inst->capabilities->cap[FIRMWARE_PRIORITY_OFFSET].value;
+
+	rc = venus_hfi_session_property(inst,
+			HFI_PROP_SESSION_PRIORITY,
+			HFI_HOST_FLAGS_NONE,
+			HFI_PORT_NONE,
+			HFI_PAYLOAD_U32,
+			&hfi_value,
+			sizeof(u32));
+	if (rc) {
+		i_vpr_e(inst, "%s: set priority %u failed\n", __func__, hfi_value);
+		return rc;
+	}
+
+	inst->shed.level = inst->shed.target;
+	if (inst->shed.level)
+		inst->shed.count++;
+	i_vpr_h(inst, "%s: %s, rt demand %llu capacity %llu\n", __func__,
+		inst->shed.level ? "shed" : "restored",
+		core->load_shed.demand, core->load_shed.capacity);
+	trace_msm_vidc_load_shed(core->id, inst->session_id,
+		inst->shed.level ? "shed" : "restore",
+		core->load_shed.demand, core->load_shed.capacity);
+
+	event.type = V4L2_EVENT_VIDC_LOAD_SHED;
+	data[0] = inst->shed.level;
+	data[1] = is_decode_session(inst) ?
+		V4L2_VIDC_SHED_SKIP_NONREF : V4L2_VIDC_SHED_RAISE_QP;
+	v4l2_event_queue_fh(&inst->event_handler, &event);
+
+	return 0;
+}
+
 int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 {
 	int rc = 0;
 	struct msm_vidc_core* core;
 	struct msm_vidc_inst* temp;
-	u64 freq;
+	u64 freq, nrt_freq, rt_freq;
 	u64 rate = 0;
-	bool increment, decrement;
+	bool increment, decrement, race_to_idle, throttled;
 	u64 curr_time_ns;
-	int i = 0;
+	int i = 0, cap, top;
+	u32 nrt_pct;
 
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -336,8 +479,14 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 	mutex_lock(&core->lock);
 	increment = false;
 	decrement = true;
+	race_to_idle = false;
 	freq = 0;
+	nrt_freq = 0;
+	rt_freq = 0;
 	curr_time_ns = ktime_get_ns();
+	/* 75%, 50%, 25% of the nrt vote across the nrt cooling states */
+	nrt_pct = 100 - 100 * min_t(u32, core->thermal.state, THERMAL_NRT_LEVELS) /
+		(THERMAL_NRT_LEVELS + 1);
 	list_for_each_entry(temp, &core->instances, list) {
 		/* skip for session where no input is there to process */
 		if (!temp->max_input_data_size)
@@ -348,7 +497,20 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 			temp->active = false;
 			continue;
 		}
-		freq += temp->power.min_freq;
+
+		if (is_realtime_session(temp))
+			rt_freq += temp->power.min_freq;
+
+		/* throttled nrt sessions run slower and never ask for more */
+		throttled = core->thermal.state && !is_realtime_session(temp);
+		if (throttled) {
+			nrt_freq += temp->power.min_freq;
+			freq += mult_frac(temp->power.min_freq, nrt_pct, 100);
+		} else {
+			freq += temp->power.min_freq;
+			if (is_throughput_session(temp))
+				race_to_idle = true;
+		}
 
 		if (msm_vidc_clock_voting) {
 			d_vpr_l("msm_vidc_clock_voting %d\n", msm_vidc_clock_voting);
@@ -357,7 +519,7 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 			break;
 		}
 		/* increment even if one session requested for it */
-		if (temp->power.dcvs_flags & MSM_VIDC_DCVS_INCR)
+		if (!throttled && (temp->power.dcvs_flags & MSM_VIDC_DCVS_INCR))
 			increment = true;
 		/* decrement only if all sessions requested for it */
 		if (!(temp->power.dcvs_flags & MSM_VIDC_DCVS_DECR))
@@ -375,15 +537,41 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 	}
 	if (i < 0)
 		i = 0;
-	if (increment) {
+	if (race_to_idle && !msm_vidc_clock_voting) {
+		/*
+		 * explicit throughput mode: run offline work at the highest
+		 * rate so it completes and the core can power collapse early.
+		 */
+		i = 0;
+	} else if (increment) {
 		if (i > 0)
-			rate = core->dt->allowed_clks_tbl[i - 1].clock_rate;
+			i--;
 	} else if (decrement) {
 		if (i < (int) (core->dt->allowed_clks_tbl_size - 1))
-			rate = core->dt->allowed_clks_tbl[i + 1].clock_rate;
-	}
+			i++;
+	}
+
+	/* beyond the nrt states, cap the table index for every session */
+	cap = (int)core->thermal.state - THERMAL_NRT_LEVELS;
+	if (cap > 0 && i < cap) {
+		i = min_t(int, cap, core->dt->allowed_clks_tbl_size - 1);
+		trace_msm_vidc_thermal_throttle(core->id, core->thermal.state, "clock cap",
+			freq, core->dt->allowed_clks_tbl[i].clock_rate);
+		core->thermal.throttle_count++;
+	} else if (nrt_freq && nrt_pct < 100) {
+		trace_msm_vidc_thermal_throttle(core->id, core->thermal.state, "nrt scale",
+			nrt_freq, mult_frac(nrt_freq, nrt_pct, 100));
+		core->thermal.throttle_count++;
+	}
+	rate = core->dt->allowed_clks_tbl[i].clock_rate;
 	core->power.clk_freq = (u32)rate;
 
+	/* highest rate the core may run at right now */
+	top = clamp_t(int, cap, 0, core->dt->allowed_clks_tbl_size - 1);
+	if (core->capabilities[RT_LOAD_SHEDDING].value && !msm_vidc_clock_voting)
+		msm_vidc_select_shed_sessions(core, rt_freq,
+			core->dt->allowed_clks_tbl[top].clock_rate);
+
 	i_vpr_p(inst, "%s: clock rate %llu requested %llu increment %d decrement %d\n",
 		__func__, rate, freq, increment, decrement);
 	mutex_unlock(&core->lock);
@@ -491,6 +679,11 @@ int msm_vidc_scale_clocks(struct msm_vidc_inst *inst)
 	} else if (msm_vidc_clock_voting) {
 		inst->power.min_freq = msm_vidc_clock_voting;
 		inst->power.dcvs_flags = 0;
+	} else if (is_throughput_session(inst)) {
+		/* no frame rate target to track, core clock is voted at max */
+		inst->power.min_freq =
+			call_session_op(core, calc_freq, inst, inst->max_input_data_size);
+		inst->power.dcvs_flags = 0;
 	} else {
 		inst->power.min_freq =
 			call_session_op(core, calc_freq, inst, inst->max_input_data_size);
@@ -559,6 +752,9 @@ int msm_vidc_scale_power(struct msm_vidc_inst *inst, bool scale_buses)
 	if (msm_vidc_scale_clocks(inst))
 		i_vpr_e(inst, "failed to scale clock\n");
 
+	if (inst->shed.target != inst->shed.level)
+		msm_vidc_apply_shed(inst);
+
 	if (scale_buses) {
 		if (msm_vidc_scale_buses(inst))
 			i_vpr_e(inst, "failed to scale bus\n");
@@ -635,3 +831,102 @@ void msm_vidc_power_data_reset(struct msm_vidc_inst *inst)
 	if (rc)
 		i_vpr_e(inst, "%s: failed to scale power\n", __func__);
 }
+
+static int msm_vidc_cdev_get_max_state(struct thermal_cooling_device *cdev,
+	unsigned long *state)
+{
+	struct msm_vidc_core *core = cdev->devdata;
+
+	*state = core->thermal.max_state;
+
+	return 0;
+}
+
+static int msm_vidc_cdev_get_cur_state(struct thermal_cooling_device *cdev,
+	unsigned long *state)
+{
+	struct msm_vidc_core *core = cdev->devdata;
+
+	*state = core->thermal.state;
+
+	return 0;
+}
+
+/*
+ * The new state is applied by the next clock vote, which every qbuf of an
+ * active session triggers through msm_vidc_scale_power().
+ */
+static int msm_vidc_cdev_set_cur_state(struct thermal_cooling_device *cdev,
+	unsigned long state)
+{
+	struct msm_vidc_core *core = cdev->devdata;
+
+	if (state > core->thermal.max_state)
+		return -EINVAL;
+
+	mutex_lock(&core->lock);
+	if (core->thermal.state != state) {
+		d_vpr_h("%s: core%u thermal state %lu -> %lu\n", __func__,
+			core->id, core->thermal.state, state);
+		trace_msm_vidc_thermal_throttle(core->id, state,
+			state > core->thermal.state ? "throttle" : "unthrottle",
+			core->power.clk_freq, core->power.clk_freq);
+		core->thermal.state = state;
+	}
+	mutex_unlock(&core->lock);
+
+	return 0;
+}
+
+static const struct thermal_cooling_device_ops msm_vidc_cdev_ops = {
+	.get_max_state = msm_vidc_cdev_get_max_state,
+	.get_cur_state = msm_vidc_cdev_get_cur_state,
+	.set_cur_state = msm_vidc_cdev_set_cur_state,
+};
+
+int msm_vidc_thermal_init(struct msm_vidc_core *core)
+{
+	struct device_node *np;
+	struct thermal_cooling_device *cdev;
+	char name[THERMAL_NAME_LENGTH];
+
+	if (!core || !core->capabilities || !core->dt) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	np = core->pdev->dev.of_node;
+	if (!core->capabilities[THERMAL_MITIGATION].value ||
+		!of_find_property(np, "#cooling-cells", NULL)) {
+		d_vpr_h("%s: thermal mitigation not enabled\n", __func__);
+		return 0;
+	}
+
+	core->thermal.state = 0;
+	core->thermal.max_state = THERMAL_NRT_LEVELS;
+	if (core->dt->allowed_clks_tbl_size > 1)
+		core->thermal.max_state += core->dt->allowed_clks_tbl_size - 1;
+
+	snprintf(name, sizeof(name), "video%u", core->id);
+	cdev = thermal_of_cooling_device_register(np, name, core, &msm_vidc_cdev_ops);
+	if (IS_ERR(cdev)) {
+		d_vpr_e("%s: cooling device register failed %ld\n",
+			__func__, PTR_ERR(cdev));
+		return PTR_ERR(cdev);
+	}
+	core->thermal.cdev = cdev;
+	d_vpr_h("%s: %s registered with %lu states\n",
+		__func__, name, core->thermal.max_state);
+
+	return 0;
+}
+
+void msm_vidc_thermal_deinit(struct msm_vidc_core *core)
+{
+	if (!core || !core->thermal.cdev)
+		return;
+
+	thermal_cooling_device_unregister(core->thermal.cdev);
+	core->thermal.cdev = NULL;
+	core->thermal.state = 0;
+}
@@ -23,11 +23,41 @@
 
 #define BASE_DEVICE_NUMBER 32
 
-struct msm_vidc_core *g_core;
+static struct dentry *msm_vidc_debugfs_drv;
+static u32 msm_vidc_debugfs_refs;
 
 const char video_banner[] = "Video-Banner: (" VIDEO_COMPILE_BY "@"
 	VIDEO_COMPILE_HOST ") (" VIDEO_COMPILE_TIME ")";
 
+/* "msm_vidc" debugfs dir is shared by all cores, removed with the last one */
+static struct dentry *msm_vidc_debugfs_get_drv(void)
+{
+	struct dentry *dir;
+
+	mutex_lock(&msm_vidc_cores_lock);
+	if (!msm_vidc_debugfs_drv)
+		msm_vidc_debugfs_drv = msm_vidc_debugfs_init_drv();
+	if (msm_vidc_debugfs_drv)
+		msm_vidc_debugfs_refs++;
+	dir = msm_vidc_debugfs_drv;
+	mutex_unlock(&msm_vidc_cores_lock);
+
+	return dir;
+}
+
+static void msm_vidc_debugfs_put_drv(struct dentry *dir)
+{
+	if (!dir)
+		return;
+
+	mutex_lock(&msm_vidc_cores_lock);
+	if (dir == msm_vidc_debugfs_drv && !--msm_vidc_debugfs_refs) {
+		debugfs_remove_recursive(msm_vidc_debugfs_drv);
+		msm_vidc_debugfs_drv = NULL;
+	}
+	mutex_unlock(&msm_vidc_cores_lock);
+}
+
 static int msm_vidc_deinit_irq(struct msm_vidc_core *core)
 {
 	struct msm_vidc_dt *dt;
@@ -40,6 +70,9 @@ static int msm_vidc_deinit_irq(struct msm_vidc_core *core)
 	d_vpr_h("%s: reg_base = %pa, reg_size = %#x\n",
 		__func__, &dt->register_base, dt->register_size);
 
+	/* affinity hint must be gone before devm frees the irq */
+	if (dt->irq)
+		irq_set_affinity_hint(dt->irq, NULL);
 	dt->irq = 0;
 
 	if (core->register_base_addr)
@@ -76,6 +109,12 @@ static int msm_vidc_init_irq(struct msm_vidc_core *core)
 	}
 	disable_irq_nosync(dt->irq);
 
+	/* module params carry the defaults, sysfs changes them per core */
+	if (!cpumask_empty(&msm_vidc_irq_cpus))
+		msm_vidc_set_irq_affinity(core, &msm_vidc_irq_cpus);
+	if (msm_vidc_irq_sched)
+		msm_vidc_set_irq_sched(core, msm_vidc_irq_sched);
+
 	d_vpr_h("%s: reg_base = %pa, reg_size = %d\n",
 		__func__, &dt->register_base, dt->register_size);
 
@@ -111,8 +150,82 @@ static ssize_t sku_version_show(struct device *dev,
 
 static DEVICE_ATTR_RO(sku_version);
 
+static ssize_t irq_cpus_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct msm_vidc_core *core = dev_get_drvdata(dev);
+
+	if (!core)
+		return 0;
+
+	return scnprintf(buf, PAGE_SIZE, "%*pbl\n",
+			cpumask_pr_args(&core->irq_cpus));
+}
+
+static ssize_t irq_cpus_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct msm_vidc_core *core = dev_get_drvdata(dev);
+	cpumask_var_t mask;
+	int rc;
+
+	if (!core)
+		return -EINVAL;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	rc = cpulist_parse(buf, mask);
+	if (!rc) {
+		core_lock(core, __func__);
+		rc = msm_vidc_set_irq_affinity(core, mask);
+		core_unlock(core, __func__);
+	}
+	free_cpumask_var(mask);
+
+	return rc ? rc : count;
+}
+
+static DEVICE_ATTR_RW(irq_cpus);
+
+static ssize_t irq_sched_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct msm_vidc_core *core = dev_get_drvdata(dev);
+
+	if (!core)
+		return 0;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", core->irq_sched);
+}
+
+static ssize_t irq_sched_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct msm_vidc_core *core = dev_get_drvdata(dev);
+	u32 sched;
+	int rc;
+
+	if (!core)
+		return -EINVAL;
+
+	rc = kstrtouint(buf, 0, &sched);
+	if (rc)
+		return rc;
+
+	core_lock(core, __func__);
+	rc = msm_vidc_set_irq_sched(core, sched);
+	core_unlock(core, __func__);
+
+	return rc ? rc : count;
+}
+
+static DEVICE_ATTR_RW(irq_sched);
+
 static struct attribute *msm_vidc_core_attrs[] = {
 	&dev_attr_sku_version.attr,
+	&dev_attr_irq_cpus.attr,
+	&dev_attr_irq_sched.attr,
 	NULL
 };
 
@@ -269,12 +382,18 @@ static int msm_vidc_deinitialize_core(struct msm_vidc_core *core)
 	core->response_packet = NULL;
 	core->packet = NULL;
 
+	cancel_delayed_work_sync(&core->stats_work);
+	cancel_delayed_work_sync(&core->nrt_sched.work);
+	if (core->inst_workq)
+		destroy_workqueue(core->inst_workq);
+
 	if (core->batch_workq)
 		destroy_workqueue(core->batch_workq);
 
 	if (core->pm_workq)
 		destroy_workqueue(core->pm_workq);
 
+	core->inst_workq = NULL;
 	core->batch_workq = NULL;
 	core->pm_workq = NULL;
 
@@ -293,20 +412,27 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 
 	msm_vidc_change_core_state(core, MSM_VIDC_CORE_DEINIT, __func__);
 
-	core->pm_workq = create_singlethread_workqueue("pm_workq");
+	core->pm_workq = msm_vidc_create_workqueue("pm_workq");
 	if (!core->pm_workq) {
 		d_vpr_e("%s: create pm workq failed\n", __func__);
 		rc = -EINVAL;
 		goto exit;
 	}
 
-	core->batch_workq = create_singlethread_workqueue("batch_workq");
+	core->batch_workq = msm_vidc_create_workqueue("batch_workq");
 	if (!core->batch_workq) {
 		d_vpr_e("%s: create batch workq failed\n", __func__);
 		rc = -EINVAL;
 		goto exit;
 	}
 
+	core->inst_workq = msm_vidc_create_workqueue("inst_workq");
+	if (!core->inst_workq) {
+		d_vpr_e("%s: create inst workq failed\n", __func__);
+		rc = -EINVAL;
+		goto exit;
+	}
+
 	core->packet_size = VIDC_IFACEQ_VAR_HUGE_PKT_SIZE;
 	rc = msm_vidc_vmem_alloc(core->packet_size,
 			(void **)&core->packet, "core packet");
@@ -321,10 +447,17 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 	mutex_init(&core->lock);
 	INIT_LIST_HEAD(&core->instances);
 	INIT_LIST_HEAD(&core->dangling_instances);
+	INIT_LIST_HEAD(&core->cmdq_backlog.list);
 
 	INIT_DELAYED_WORK(&core->pm_work, venus_hfi_pm_work_handler);
+	INIT_DELAYED_WORK(&core->cmdq_backlog.work, venus_hfi_cmdq_backlog_handler);
 	INIT_DELAYED_WORK(&core->fw_unload_work, msm_vidc_fw_unload_handler);
+	INIT_WORK(&core->fw_preload_work, msm_vidc_fw_preload_handler);
+	INIT_DELAYED_WORK(&core->stats_work, msm_vidc_stats_handler);
+	INIT_DELAYED_WORK(&core->nrt_sched.work, msm_vidc_nrt_sched_handler);
 	INIT_WORK(&core->ssr_work, msm_vidc_ssr_handler);
+	INIT_WORK(&core->recovery_work, msm_vidc_recovery_handler);
+	INIT_WORK(&core->fw_dump.work, fw_coredump_handler);
 
 	return 0;
 exit:
@@ -332,10 +465,13 @@ exit:
 	msm_vidc_vmem_free((void **)&core->packet);
 	core->response_packet = NULL;
 	core->packet = NULL;
+	if (core->inst_workq)
+		destroy_workqueue(core->inst_workq);
 	if (core->batch_workq)
 		destroy_workqueue(core->batch_workq);
 	if (core->pm_workq)
 		destroy_workqueue(core->pm_workq);
+	core->inst_workq = NULL;
 	core->batch_workq = NULL;
 	core->pm_workq = NULL;
 
@@ -385,6 +521,13 @@ static int msm_vidc_component_bind(struct device *dev)
 		goto queues_deinit;
 	}
 
+	/* load and boot the firmware off the probe path */
+	if (core->capabilities[FW_PRELOAD].value) {
+		queue_work(system_unbound_wq, &core->fw_preload_work);
+		d_vpr_h("%s(): succssful, fw preload queued\n", __func__);
+		goto exit;
+	}
+
 	rc = msm_vidc_core_init(core);
 	if (rc) {
 		d_vpr_e("%s: sys init failed\n", __func__);
@@ -392,8 +535,7 @@ static int msm_vidc_component_bind(struct device *dev)
 	}
 
 	d_vpr_h("%s(): succssful\n", __func__);
-
-	return 0;
+	goto exit;
 
 queues_deinit:
 	venus_hfi_interface_queues_deinit(core);
@@ -401,6 +543,9 @@ queues_deinit:
 	 * queues and core can be inited again during session_open.
 	 * So don't declare as probe failure.
 	 */
+exit:
+	/* fully set up, now visible to the other cores */
+	msm_vidc_register_core(core);
 	return 0;
 }
 
@@ -410,6 +555,9 @@ static void msm_vidc_component_unbind(struct device *dev)
 
 	d_vpr_h("%s(): %s\n", __func__, dev_name(dev));
 
+	msm_vidc_unregister_core(core);
+	cancel_work_sync(&core->fw_preload_work);
+	cancel_work_sync(&core->recovery_work);
 	msm_vidc_core_deinit(core, true);
 	venus_hfi_interface_queues_deinit(core);
 	component_unbind_all(dev, core);
@@ -443,6 +591,9 @@ static int msm_vidc_remove_video_device(struct platform_device *pdev)
 
 	d_vpr_h("%s()\n", __func__);
 
+	/* no other core may reach this one's sessions from here on */
+	msm_vidc_unregister_core(core);
+
 	/* destroy component master and deallocate match data */
 	component_master_del(&pdev->dev, &msm_vidc_component_ops);
 
@@ -469,6 +620,7 @@ static int msm_vidc_remove_video_device(struct platform_device *pdev)
 	v4l2_device_unregister(&core->v4l2_dev);
 	sysfs_remove_group(&pdev->dev.kobj, &msm_vidc_core_attr_group);
 
+	msm_vidc_thermal_deinit(core);
 	msm_vidc_deinit_instance_caps(core);
 	msm_vidc_deinit_core_caps(core);
 
@@ -478,9 +630,10 @@ static int msm_vidc_remove_video_device(struct platform_device *pdev)
 	msm_vidc_deinitialize_core(core);
 
 	dev_set_drvdata(&pdev->dev, NULL);
-	debugfs_remove_recursive(core->debugfs_parent);
+	debugfs_remove_recursive(core->debugfs_root);
+	msm_vidc_debugfs_put_drv(core->debugfs_parent);
+	msm_vidc_free_core_id(core);
 	msm_vidc_vmem_free((void **)&core);
-	g_core = NULL;
 	d_vpr_h("%s(): succssful\n", __func__);
 
 	return 0;
@@ -521,16 +674,23 @@ static int msm_vidc_probe_video_device(struct platform_device *pdev)
 	struct component_match *match = NULL;
 	struct msm_vidc_core *core = NULL;
 	struct device_node *child = NULL;
-	int sub_device_count = 0, nr = BASE_DEVICE_NUMBER;
+	int sub_device_count = 0, nr;
 
 	d_vpr_h("%s()\n", __func__);
 
 	rc = msm_vidc_vmem_alloc(sizeof(*core), (void **)&core, __func__);
 	if (rc)
 		return rc;
-	g_core = core;
 
-	core->debugfs_parent = msm_vidc_debugfs_init_drv();
+	rc = msm_vidc_alloc_core_id(core);
+	if (rc) {
+		msm_vidc_vmem_free((void **)&core);
+		return rc;
+	}
+	/* each core owns a decoder and an encoder device node */
+	nr = BASE_DEVICE_NUMBER + 2 * core->id;
+
+	core->debugfs_parent = msm_vidc_debugfs_get_drv();
 	if (!core->debugfs_parent)
 		d_vpr_h("Failed to create debugfs for msm_vidc\n");
 
@@ -621,6 +781,12 @@ static int msm_vidc_probe_video_device(struct platform_device *pdev)
 		rc = 0; /* Ignore error */
 	}
 
+	rc = msm_vidc_thermal_init(core);
+	if (rc) {
+		d_vpr_e("Failed to register cooling device\n");
+		rc = 0; /* Ignore error, soc wide throttling still applies */
+	}
+
 	core->debugfs_root = msm_vidc_debugfs_init_core(core);
 	if (!core->debugfs_root)
 		d_vpr_h("Failed to init debugfs core\n");
@@ -665,8 +831,10 @@ static int msm_vidc_probe_video_device(struct platform_device *pdev)
 	return rc;
 
 master_add_failed:
+	msm_vidc_unregister_core(core);
 	of_platform_depopulate(&pdev->dev);
 sub_dev_failed:
+	msm_vidc_thermal_deinit(core);
 #ifdef CONFIG_MEDIA_CONTROLLER
 	media_device_unregister(&core->media_dev);
 media_reg_failed:
@@ -692,9 +860,10 @@ init_dt_failed:
 	msm_vidc_deinitialize_core(core);
 init_core_failed:
 	dev_set_drvdata(&pdev->dev, NULL);
-	debugfs_remove_recursive(core->debugfs_parent);
+	debugfs_remove_recursive(core->debugfs_root);
+	msm_vidc_debugfs_put_drv(core->debugfs_parent);
+	msm_vidc_free_core_id(core);
 	msm_vidc_vmem_free((void **)&core);
-	g_core = NULL;
 
 	return rc;
 }
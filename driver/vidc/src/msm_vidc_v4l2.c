@@ -12,8 +12,6 @@
 #include "msm_vidc.h"
 #include "msm_vidc_events.h"
 
-extern struct msm_vidc_core *g_core;
-
 static struct msm_vidc_inst *get_vidc_inst(struct file *filp, void *fh)
 {
 	if (!filp || !filp->private_data)
@@ -70,7 +68,7 @@ int msm_v4l2_querycap(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -96,7 +94,7 @@ int msm_v4l2_enum_fmt(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -121,7 +119,7 @@ int msm_v4l2_try_fmt(struct file *filp, void *fh, struct v4l2_format *f)
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -152,7 +150,7 @@ int msm_v4l2_s_fmt(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -183,7 +181,7 @@ int msm_v4l2_g_fmt(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -209,7 +207,7 @@ int msm_v4l2_s_selection(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -240,7 +238,7 @@ int msm_v4l2_g_selection(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -266,7 +264,7 @@ int msm_v4l2_s_parm(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -297,7 +295,7 @@ int msm_v4l2_g_parm(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -323,7 +321,7 @@ int msm_v4l2_reqbufs(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -349,7 +347,7 @@ int msm_v4l2_querybuf(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -375,7 +373,7 @@ int msm_v4l2_create_bufs(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -402,7 +400,7 @@ int msm_v4l2_prepare_buf(struct file *filp, void *fh,
 	struct video_device *vdev = video_devdata(filp);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -429,7 +427,7 @@ int msm_v4l2_qbuf(struct file *filp, void *fh,
 	struct video_device *vdev = video_devdata(filp);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -459,7 +457,7 @@ int msm_v4l2_dqbuf(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -479,13 +477,145 @@ unlock:
 	return rc;
 }
 
+static int msm_v4l2_copy_buf_from_user(struct v4l2_buffer *b,
+	struct v4l2_plane *planes, struct v4l2_plane __user **uplanes,
+	struct v4l2_buffer __user *ubuf)
+{
+	if (copy_from_user(b, ubuf, sizeof(*b)))
+		return -EFAULT;
+
+	*uplanes = NULL;
+	if (!V4L2_TYPE_IS_MULTIPLANAR(b->type))
+		return 0;
+
+	if (!b->length || b->length > VIDEO_MAX_PLANES || !b->m.planes)
+		return -EINVAL;
+	*uplanes = (struct v4l2_plane __user *)b->m.planes;
+	if (copy_from_user(planes, *uplanes, b->length * sizeof(*planes)))
+		return -EFAULT;
+	b->m.planes = planes;
+
+	return 0;
+}
+
+static int msm_v4l2_copy_buf_to_user(struct v4l2_buffer __user *ubuf,
+	struct v4l2_buffer *b, struct v4l2_plane *planes,
+	struct v4l2_plane __user *uplanes)
+{
+	if (V4L2_TYPE_IS_MULTIPLANAR(b->type)) {
+		if (copy_to_user(uplanes, planes, b->length * sizeof(*planes)))
+			return -EFAULT;
+		b->m.planes = (struct v4l2_plane *)uplanes;
+	}
+
+	if (copy_to_user(ubuf, b, sizeof(*b)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int msm_v4l2_buf_batch(struct file *filp, struct msm_vidc_inst *inst,
+	struct v4l2_vidc_buf_batch *batch, bool queue)
+{
+	struct video_device *vdev = video_devdata(filp);
+	struct v4l2_buffer __user *ubufs;
+	struct v4l2_plane __user *uplanes;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct v4l2_buffer b;
+	u32 i, count;
+	int rc = 0, rc_end;
+
+	count = batch->count;
+	if (!count || count > MSM_VIDC_MAX_BUF_BATCH) {
+		i_vpr_e(inst, "%s: invalid count %u\n", __func__, count);
+		return -EINVAL;
+	}
+	ubufs = u64_to_user_ptr(batch->buffers);
+	batch->count = 0;
+
+	/* one lock acquisition for the whole batch */
+	client_lock(inst, __func__);
+	inst_lock(inst, __func__);
+	if (queue)
+		msm_vidc_qbuf_batch_begin(inst);
+
+	for (i = 0; i < count; i++) {
+		rc = msm_v4l2_copy_buf_from_user(&b, planes, &uplanes, &ubufs[i]);
+		if (rc)
+			break;
+
+		if (queue) {
+			/* requests need ctrl setup outside of inst lock */
+			if (b.flags & V4L2_BUF_FLAG_REQUEST_FD) {
+				rc = -EINVAL;
+				break;
+			}
+			rc = msm_vidc_qbuf(inst, vdev->v4l2_dev->mdev, &b);
+		} else {
+			rc = msm_vidc_dqbuf(inst, &b);
+		}
+		if (rc)
+			break;
+
+		rc = msm_v4l2_copy_buf_to_user(&ubufs[i], &b, planes, uplanes);
+		if (rc)
+			break;
+		batch->count++;
+	}
+
+	if (queue) {
+		rc_end = msm_vidc_qbuf_batch_end(inst);
+		inst->qbuf_batch.calls++;
+		inst->qbuf_batch.buffers += batch->count;
+		if (!rc)
+			rc = rc_end;
+	}
+	inst_unlock(inst, __func__);
+	client_unlock(inst, __func__);
+
+	/* usercopy drops arg on error, so partial success must return 0 */
+	if (batch->count)
+		rc = 0;
+
+	return rc;
+}
+
+long msm_v4l2_default(struct file *filp, void *fh,
+	bool valid_prio, unsigned int cmd, void *arg)
+{
+	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
+	long rc = 0;
+
+	inst = get_inst_ref_self(inst);
+	if (!inst) {
+		d_vpr_e("%s: invalid instance\n", __func__);
+		return -EINVAL;
+	}
+
+	switch (cmd) {
+	case VIDIOC_VIDC_QBUF_BATCH:
+		rc = msm_v4l2_buf_batch(filp, inst, arg, true);
+		break;
+	case VIDIOC_VIDC_DQBUF_BATCH:
+		rc = msm_v4l2_buf_batch(filp, inst, arg, false);
+		break;
+	default:
+		rc = -ENOTTY;
+		break;
+	}
+
+	put_inst(inst);
+
+	return rc;
+}
+
 int msm_v4l2_streamon(struct file *filp, void *fh,
 				enum v4l2_buf_type i)
 {
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -507,7 +637,7 @@ int msm_v4l2_streamoff(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -530,7 +660,7 @@ int msm_v4l2_subscribe_event(struct v4l2_fh *fh,
 	int rc = 0;
 
 	inst = container_of(fh, struct msm_vidc_inst, event_handler);
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -562,7 +692,7 @@ int msm_v4l2_unsubscribe_event(struct v4l2_fh *fh,
 	int rc = 0;
 
 	inst = container_of(fh, struct msm_vidc_inst, event_handler);
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -588,7 +718,7 @@ int msm_v4l2_try_decoder_cmd(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -619,7 +749,7 @@ int msm_v4l2_decoder_cmd(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -650,7 +780,7 @@ int msm_v4l2_try_encoder_cmd(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -681,7 +811,7 @@ int msm_v4l2_encoder_cmd(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -712,7 +842,7 @@ int msm_v4l2_enum_framesizes(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -738,7 +868,7 @@ int msm_v4l2_enum_frameintervals(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -764,7 +894,7 @@ int msm_v4l2_queryctrl(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
@@ -790,7 +920,7 @@ int msm_v4l2_querymenu(struct file *filp, void *fh,
 	struct msm_vidc_inst *inst = get_vidc_inst(filp, fh);
 	int rc = 0;
 
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst) {
 		d_vpr_e("%s: invalid instance\n", __func__);
 		return -EINVAL;
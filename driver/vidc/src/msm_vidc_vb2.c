@@ -14,8 +14,7 @@
 #include "msm_venc.h"
 #include "msm_vidc_debug.h"
 #include "msm_vidc_control.h"
-
-extern struct msm_vidc_core *g_core;
+#include "msm_vidc_buffer.h"
 
 struct vb2_queue *msm_vidc_get_vb2q(struct msm_vidc_inst *inst,
 	u32 type, const char *func)
@@ -98,6 +97,7 @@ int msm_vidc_queue_setup(struct vb2_queue *q,
 	int rc = 0;
 	struct msm_vidc_inst *inst;
 	int port;
+	u32 size = 0;
 	struct v4l2_format *f;
 
 	if (!q || !num_buffers || !num_planes
@@ -121,6 +121,14 @@ int msm_vidc_queue_setup(struct vb2_queue *q,
 	if (port < 0)
 		return -EINVAL;
 
+	if (port == INPUT_PORT || port == OUTPUT_PORT) {
+		size = inst->fmts[port].fmt.pix_mp.plane_fmt[0].sizeimage;
+		/* bitstream port size may be shrunk by adaptive sizing */
+		if ((is_decode_session(inst) && port == INPUT_PORT) ||
+			(is_encode_session(inst) && port == OUTPUT_PORT))
+			size = msm_vidc_get_bitstream_size(inst, size);
+	}
+
 	if (*num_planes && (port == INPUT_PORT || port == OUTPUT_PORT)) {
 		f = &inst->fmts[port];
 		if (*num_planes != f->fmt.pix_mp.num_planes) {
@@ -128,7 +136,7 @@ int msm_vidc_queue_setup(struct vb2_queue *q,
 			__func__, *num_planes, f->fmt.pix_mp.num_planes);
 			return -EINVAL;
 		}
-		if (sizes[0] < inst->fmts[port].fmt.pix_mp.plane_fmt[0].sizeimage) {
+		if (sizes[0] < size) {
 			i_vpr_e(inst, "%s: requested size %d not acceptable\n",
 			__func__, sizes[0]);
 			return -EINVAL;
@@ -170,7 +178,7 @@ int msm_vidc_queue_setup(struct vb2_queue *q,
 	}
 
 	if (port == INPUT_PORT || port == OUTPUT_PORT) {
-		sizes[0] = inst->fmts[port].fmt.pix_mp.plane_fmt[0].sizeimage;
+		sizes[0] = size;
 	} else if (port == OUTPUT_META_PORT) {
 		sizes[0] = inst->fmts[port].fmt.meta.buffersize;
 	} else if (port == INPUT_META_PORT) {
@@ -198,7 +206,7 @@ int msm_vidc_start_streaming(struct vb2_queue *q, unsigned int count)
 		return -EINVAL;
 	}
 	inst = q->drv_priv;
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst || !inst->core || !inst->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
@@ -240,39 +248,14 @@ int msm_vidc_start_streaming(struct vb2_queue *q, unsigned int count)
 	}
 	i_vpr_h(inst, "Streamon: %s\n", v4l2_type_name(q->type));
 
-	if (!inst->once_per_session_set) {
-		inst->once_per_session_set = true;
-		rc = msm_vidc_prepare_dependency_list(inst);
-		if (rc)
-			goto unlock;
-
-		rc = msm_vidc_session_set_codec(inst);
-		if (rc)
-			goto unlock;
-
-		rc = msm_vidc_session_set_secure_mode(inst);
-		if (rc)
-			goto unlock;
-
-		if (is_encode_session(inst)) {
-			rc = msm_vidc_alloc_and_queue_session_internal_buffers(inst,
-				MSM_VIDC_BUF_ARP);
-			if (rc)
-				goto unlock;
-		} else if(is_decode_session(inst)) {
-			rc = msm_vidc_session_set_default_header(inst);
-			if (rc)
-				goto unlock;
-
-			rc = msm_vidc_alloc_and_queue_session_internal_buffers(inst,
-				MSM_VIDC_BUF_PERSIST);
-			if (rc)
-				goto unlock;
-		}
-	}
+	rc = msm_vidc_session_streamon_prepare(inst);
+	if (rc)
+		goto unlock;
 
 	if (is_decode_session(inst))
 		inst->decode_batch.enable = msm_vidc_allow_decode_batch(inst);
+	else if (is_encode_session(inst) && q->type == INPUT_MPLANE)
+		inst->encode_batch.enable = msm_vidc_allow_encode_batch(inst);
 
 	msm_vidc_allow_dcvs(inst);
 	msm_vidc_power_data_reset(inst);
@@ -350,7 +333,7 @@ void msm_vidc_stop_streaming(struct vb2_queue *q)
 		return;
 	}
 	inst = q->drv_priv;
-	inst = get_inst_ref(g_core, inst);
+	inst = get_inst_ref_self(inst);
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
@@ -431,6 +414,7 @@ void msm_vidc_buf_queue(struct vb2_buffer *vb2)
 	struct msm_vidc_inst *inst;
 	u64 timestamp_us = 0;
 	u64 ktime_ns = ktime_get_ns();
+	bool batched;
 
 	inst = vb2_get_drv_priv(vb2->vb2_queue);
 	if (!inst) {
@@ -438,10 +422,14 @@ void msm_vidc_buf_queue(struct vb2_buffer *vb2)
 		return;
 	}
 
-	inst = get_inst_ref(g_core, inst);
-	if (!inst) {
-		d_vpr_e("%s: invalid instance\n", __func__);
-		return;
+	/* batched qbuf already holds the instance reference and locks */
+	batched = inst->qbuf_batch.owner == current;
+	if (!batched) {
+		inst = get_inst_ref_self(inst);
+		if (!inst) {
+			d_vpr_e("%s: invalid instance\n", __func__);
+			return;
+		}
 	}
 
 	/*
@@ -463,8 +451,10 @@ void msm_vidc_buf_queue(struct vb2_buffer *vb2)
 	 * would call .s_ctrl and .g_volatile_ctrl respectively which acquire
 	 * lock too.
 	 */
-	client_lock(inst, __func__);
-	inst_lock(inst, __func__);
+	if (!batched) {
+		client_lock(inst, __func__);
+		inst_lock(inst, __func__);
+	}
 	if (rc) {
 		i_vpr_e(inst, "%s: request setup failed, error %d\n",
 			__func__, rc);
@@ -531,6 +521,8 @@ unlock:
 		msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
 		vb2_buffer_done(vb2, VB2_BUF_STATE_ERROR);
 	}
+	if (batched)
+		return;
 	inst_unlock(inst, __func__);
 	client_unlock(inst, __func__);
 	put_inst(inst);
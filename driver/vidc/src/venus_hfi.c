@@ -4,6 +4,7 @@
  */
 /* Copyright (c) 2022. Qualcomm Innovation Center, Inc. All rights reserved. */
 
+#include <linux/sched.h>
 #include <linux/iommu.h>
 #include <linux/qcom_scm.h>
 #include <linux/soc/qcom/smem.h>
@@ -38,10 +39,9 @@
 		(ts) *= NSEC_PER_USEC; \
 	} while (0)
 
-extern struct msm_vidc_core *g_core;
-
 static int __resume(struct msm_vidc_core *core);
 static int __suspend(struct msm_vidc_core *core);
+static int __release_subcaches(struct msm_vidc_core *core);
 
 struct tzbsp_memprot {
 	u32 cp_start;
@@ -354,8 +354,68 @@ int __read_register_with_poll_timeout(struct msm_vidc_core *core,
 	return rc;
 }
 
+#define PC_RESUME_COST_US_DEFAULT 5000
+#define PC_MAX_BACKOFF 4
+
+/* idle gap for which a collapse pays for the resume that follows it */
+static u32 __pc_break_even_us(struct msm_vidc_core *core)
+{
+	struct msm_vidc_pc_predictor *pred = &core->pc_predictor;
+	u32 cost, min_idle_us;
+
+	cost = pred->resume_cost_us ? pred->resume_cost_us : PC_RESUME_COST_US_DEFAULT;
+	min_idle_us = core->capabilities[PC_MIN_IDLE].value * USEC_PER_MSEC;
+
+	return max(2 * cost, min_idle_us) << pred->backoff;
+}
+
+/*
+ * Predict the idle gap ahead from the observed gaps between the last fw
+ * response and the next command, bounded by the shortest frame interval
+ * of the streaming sessions. NRT sessions queue back to back, so their
+ * presence means no gap. Called with core->lock held on every cmdq write.
+ */
+static void __pc_predict_gap(struct msm_vidc_core *core)
+{
+	struct msm_vidc_pc_predictor *pred = &core->pc_predictor;
+	struct msm_vidc_inst *inst;
+	u32 fps, gap_us = U32_MAX, observed;
+	u64 now = ktime_get_ns();
+
+	if (pred->idle_start_ns && now > pred->idle_start_ns) {
+		observed = (u32)min_t(u64, div_u64(now - pred->idle_start_ns,
+			NSEC_PER_USEC), U32_MAX);
+		pred->idle_avg_us = pred->idle_avg_us ?
+			(pred->idle_avg_us * 7 + observed) / 8 : observed;
+		pred->idle_start_ns = 0;
+	}
+
+	list_for_each_entry(inst, &core->instances, list) {
+		if (!is_state(inst, MSM_VIDC_STREAMING) &&
+			!is_state(inst, MSM_VIDC_INPUT_STREAMING) &&
+			!is_state(inst, MSM_VIDC_OUTPUT_STREAMING))
+			continue;
+		fps = max(msm_vidc_get_frame_rate(inst),
+			msm_vidc_get_operating_rate(inst));
+		if (!is_realtime_session(inst) || !fps) {
+			gap_us = 0;
+			break;
+		}
+		gap_us = min_t(u32, gap_us, USEC_PER_SEC / fps);
+		if (pred->idle_avg_us)
+			gap_us = min(gap_us, pred->idle_avg_us);
+	}
+	/* nothing streaming: open, seek or reconfig, trust observed idle only */
+	if (gap_us == U32_MAX)
+		gap_us = pred->idle_avg_us;
+	pred->gap_us = gap_us;
+}
+
 static void __schedule_power_collapse_work(struct msm_vidc_core *core)
 {
+	struct msm_vidc_pc_predictor *pred;
+	u32 delay_ms;
+
 	if (!core || !core->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
@@ -364,13 +424,53 @@ static void __schedule_power_collapse_work(struct msm_vidc_core *core)
 		d_vpr_l("software power collapse not enabled\n");
 		return;
 	}
+	pred = &core->pc_predictor;
+
+	/* next work predicted far away, collapse without the full delay */
+	delay_ms = core->capabilities[SW_PC_DELAY].value;
+	pred->fast_pending = core->capabilities[PC_PREDICT].value &&
+		pred->gap_us >= __pc_break_even_us(core);
+	if (pred->fast_pending)
+		delay_ms = min_t(u32, delay_ms, core->capabilities[PC_FAST_DELAY].value);
 
 	if (!mod_delayed_work(core->pm_workq, &core->pm_work,
-			msecs_to_jiffies(core->capabilities[SW_PC_DELAY].value))) {
+			msecs_to_jiffies(delay_ms))) {
 		d_vpr_h("power collapse already scheduled\n");
 	} else {
-		d_vpr_l("power collapse scheduled for %d ms\n",
-			core->capabilities[SW_PC_DELAY].value);
+		d_vpr_l("power collapse scheduled for %d ms\n", delay_ms);
+	}
+}
+
+static void __pc_update_residency(struct msm_vidc_core *core, u64 cost_ns)
+{
+	struct msm_vidc_pc_predictor *pred = &core->pc_predictor;
+	static const u32 bins_ms[PC_RESIDENCY_BINS - 1] = {10, 50, 100, 500, 1000};
+	u32 cost_us, residency_us, i;
+
+	cost_us = (u32)div_u64(cost_ns, NSEC_PER_USEC);
+	pred->resume_cost_us = pred->resume_cost_us ?
+		(pred->resume_cost_us * 7 + cost_us) / 8 : cost_us;
+	pred->resume_count++;
+
+	if (!pred->collapse_ns)
+		return;
+
+	residency_us = (u32)min_t(u64, div_u64(ktime_get_ns() - pred->collapse_ns,
+		NSEC_PER_USEC), U32_MAX);
+	pred->collapse_ns = 0;
+	for (i = 0; i < PC_RESIDENCY_BINS - 1; i++) {
+		if (residency_us < bins_ms[i] * USEC_PER_MSEC)
+			break;
+	}
+	pred->residency[i]++;
+
+	/* woke up before the collapse paid off, demand longer gaps */
+	if (residency_us < 2 * pred->resume_cost_us) {
+		pred->mispredict_short++;
+		if (pred->backoff < PC_MAX_BACKOFF)
+			pred->backoff++;
+	} else if (pred->backoff) {
+		pred->backoff--;
 	}
 }
 
@@ -624,6 +724,16 @@ int __vote_buses(struct msm_vidc_core *core,
 	return rc;
 }
 
+u64 __trace_power_step(struct msm_vidc_core *core, const char *step, u64 start_ns)
+{
+	u64 now = ktime_get_ns();
+
+	trace_msm_vidc_power_step(step, core->id,
+		div_u64(now - start_ns, NSEC_PER_USEC));
+
+	return now;
+}
+
 static int __tzbsp_set_video_state(enum tzbsp_video_state state)
 {
 	int tzbsp_rsp = qcom_scm_set_remote_state(state, 0);
@@ -779,7 +889,7 @@ static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 		(read_idx - write_idx);
 	if (empty_space <= packet_size_in_words) {
 		queue->qhdr_tx_req =  1;
-		d_vpr_e("Insufficient size (%d) to write (%d)\n",
+		d_vpr_h("Insufficient size (%d) to write (%d)\n",
 					  empty_space, packet_size_in_words);
 		return -ENOTEMPTY;
 	}
@@ -941,11 +1051,221 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	return rc;
 }
 
-/* Writes into cmdq without raising an interrupt */
+struct msm_vidc_cmdq_pkt {
+	struct list_head                   list;
+	u32                                session_id;
+	bool                               realtime;
+	u8                                *pkt;
+};
+
+static u32 __cmdq_occupancy(struct msm_vidc_iface_q_info *qinfo)
+{
+	struct hfi_queue_header *queue;
+	u32 read_idx, write_idx, q_size, used;
+
+	queue = (struct hfi_queue_header *)qinfo->q_hdr;
+	q_size = qinfo->q_array.mem_size >> 2;
+	if (!queue || !q_size)
+		return 0;
+
+	read_idx = queue->qhdr_read_idx;
+	write_idx = queue->qhdr_write_idx;
+	used = (write_idx >= read_idx) ?
+		(write_idx - read_idx) : (q_size - (read_idx - write_idx));
+
+	return (used * 100) / q_size;
+}
+
+static void __cmdq_update_hwm(struct msm_vidc_core *core,
+	struct msm_vidc_iface_q_info *qinfo)
+{
+	u32 occupancy = __cmdq_occupancy(qinfo);
+
+	if (occupancy > core->cmdq_backlog.occupancy_hwm)
+		core->cmdq_backlog.occupancy_hwm = occupancy;
+}
+
+static struct msm_vidc_inst *__cmdq_find_session(struct msm_vidc_core *core,
+	u32 session_id)
+{
+	struct msm_vidc_inst *inst;
+
+	/* core->lock is held by the cmdq writers */
+	list_for_each_entry(inst, &core->instances, list) {
+		if (inst->session_id == session_id)
+			return inst;
+	}
+
+	return NULL;
+}
+
+static void __cmdq_backlog_free(struct msm_vidc_core *core,
+	struct msm_vidc_cmdq_pkt *entry)
+{
+	list_del(&entry->list);
+	msm_vidc_vmem_free((void **)&entry->pkt);
+	msm_vidc_vmem_free((void **)&entry);
+	core->cmdq_backlog.count--;
+}
+
+static int __cmdq_backlog_add(struct msm_vidc_core *core, void *pkt)
+{
+	struct msm_vidc_cmdq_backlog *backlog = &core->cmdq_backlog;
+	struct hfi_header *hdr = (struct hfi_header *)pkt;
+	struct msm_vidc_cmdq_pkt *entry, *pos;
+	struct msm_vidc_inst *inst;
+	struct list_head *insert = &backlog->list;
+	int rc = 0;
+
+	if (backlog->count >= core->capabilities[CMDQ_BACKLOG_SIZE].value) {
+		d_vpr_e("%s: cmdq backlog full (%u)\n", __func__, backlog->count);
+		return -ENOTEMPTY;
+	}
+
+	rc = msm_vidc_vmem_alloc(sizeof(*entry), (void **)&entry, __func__);
+	if (rc)
+		return rc;
+	rc = msm_vidc_vmem_alloc(hdr->size, (void **)&entry->pkt, __func__);
+	if (rc) {
+		msm_vidc_vmem_free((void **)&entry);
+		return rc;
+	}
+	memcpy(entry->pkt, pkt, hdr->size);
+	entry->session_id = hdr->session_id;
+	inst = __cmdq_find_session(core, hdr->session_id);
+	entry->realtime = inst ? inst->cmdq_realtime : true;
+
+	/*
+	 * realtime packets go ahead of nrt ones of other sessions, but
+	 * never ahead of packets already parked for the same session
+	 */
+	if (entry->realtime) {
+		list_for_each_entry(pos, &backlog->list, list) {
+			if (pos->session_id == entry->session_id)
+				insert = &backlog->list;
+			else if (!pos->realtime && insert == &backlog->list)
+				insert = &pos->list;
+		}
+	}
+	list_add_tail(&entry->list, insert);
+
+	backlog->count++;
+	backlog->deferred_count++;
+	if (backlog->count > backlog->count_hwm)
+		backlog->count_hwm = backlog->count;
+
+	d_vpr_l("%s: session %#x deferred, backlog %u\n",
+		__func__, entry->session_id, backlog->count);
+
+	if (!delayed_work_pending(&backlog->work))
+		mod_delayed_work(core->pm_workq, &backlog->work,
+			msecs_to_jiffies(core->capabilities[CMDQ_BACKLOG_TIMEOUT].value));
+
+	return 0;
+}
+
+static void __cmdq_backlog_drain(struct msm_vidc_core *core)
+{
+	struct msm_vidc_cmdq_backlog *backlog = &core->cmdq_backlog;
+	struct msm_vidc_cmdq_pkt *entry, *dummy;
+	struct msm_vidc_iface_q_info *q_info;
+	struct msm_vidc_inst *inst;
+	bool needs_interrupt = false, raise = false;
+	u32 written = 0;
+	int rc = 0;
+
+	if (list_empty(&backlog->list))
+		return;
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	if (!__core_in_valid_state(core) || !q_info->q_array.align_virtual_addr) {
+		venus_hfi_cmdq_backlog_flush(core);
+		return;
+	}
+
+	rc = __resume(core);
+	if (rc) {
+		d_vpr_e("%s: Power on failed\n", __func__);
+		goto retry;
+	}
+
+	list_for_each_entry_safe(entry, dummy, &backlog->list, list) {
+		/* session went away while its packets were parked */
+		inst = __cmdq_find_session(core, entry->session_id);
+		if (!inst) {
+			backlog->drop_count++;
+			__cmdq_backlog_free(core, entry);
+			continue;
+		}
+
+		rc = __write_queue(q_info, entry->pkt, &needs_interrupt);
+		if (rc == -ENOTEMPTY)
+			break;
+		if (rc) {
+			d_vpr_e("%s: session %#x write failed %d\n",
+				__func__, entry->session_id, rc);
+			backlog->drop_count++;
+			/* firmware never sees this command, fail the session */
+			queue_work(core->inst_workq, &inst->cmdq_error_work);
+		} else {
+			written++;
+			raise |= needs_interrupt;
+		}
+		__cmdq_backlog_free(core, entry);
+	}
+
+	if (written) {
+		__cmdq_update_hwm(core, q_info);
+		if (raise)
+			call_venus_op(core, raise_interrupt, core);
+		__schedule_power_collapse_work(core);
+		d_vpr_l("%s: drained %u, backlog %u\n",
+			__func__, written, backlog->count);
+	}
+
+retry:
+	if (!list_empty(&backlog->list))
+		mod_delayed_work(core->pm_workq, &backlog->work,
+			msecs_to_jiffies(core->capabilities[CMDQ_BACKLOG_TIMEOUT].value));
+}
+
+void venus_hfi_cmdq_backlog_flush(struct msm_vidc_core *core)
+{
+	struct msm_vidc_cmdq_pkt *entry, *dummy;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	cancel_delayed_work(&core->cmdq_backlog.work);
+	list_for_each_entry_safe(entry, dummy, &core->cmdq_backlog.list, list) {
+		core->cmdq_backlog.drop_count++;
+		__cmdq_backlog_free(core, entry);
+	}
+}
+
+void venus_hfi_cmdq_backlog_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+
+	core = container_of(work, struct msm_vidc_core, cmdq_backlog.work.work);
+
+	core_lock(core, __func__);
+	__cmdq_backlog_drain(core);
+	core_unlock(core, __func__);
+}
+
+/*
+ * Writes into cmdq without raising an interrupt. Session packets that
+ * do not fit are parked in the core backlog instead of failing, and are
+ * written once firmware drains the cmdq.
+ */
 static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
 		void *pkt, bool *requires_interrupt)
 {
 	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_header *hdr;
 	//struct vidc_hal_cmd_pkt_hdr *cmd_packet;
 	int rc = -E2BIG;
 
@@ -986,9 +1306,32 @@ static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
 		goto err_q_write;
 	}
 
-	if (!__write_queue(q_info, (u8 *)pkt, requires_interrupt)) {
+	__pc_predict_gap(core);
+
+	/* keep session packets behind the ones already parked */
+	hdr = (struct hfi_header *)pkt;
+	if (hdr->session_id && !list_empty(&core->cmdq_backlog.list)) {
+		rc = __cmdq_backlog_add(core, pkt);
+		__cmdq_backlog_drain(core);
+		goto err_q_write;
+	}
+
+	/* system packets must not overtake parked session packets */
+	if (!hdr->session_id && !list_empty(&core->cmdq_backlog.list)) {
+		__cmdq_backlog_drain(core);
+		if (!list_empty(&core->cmdq_backlog.list)) {
+			d_vpr_h("%s: cmdq backlog pending, retry\n", __func__);
+			rc = -EAGAIN;
+			goto err_q_write;
+		}
+	}
+
+	rc = __write_queue(q_info, (u8 *)pkt, requires_interrupt);
+	if (!rc) {
+		__cmdq_update_hwm(core, q_info);
 		__schedule_power_collapse_work(core);
-		rc = 0;
+	} else if (rc == -ENOTEMPTY && hdr->session_id) {
+		rc = __cmdq_backlog_add(core, pkt);
 	} else {
 		d_vpr_e("__iface_cmdq_write: queue full\n");
 	}
@@ -1254,8 +1597,23 @@ static int __power_collapse(struct msm_vidc_core *core, bool force)
 		return -EINVAL;
 	}
 
+	/* parked session packets have to reach firmware before pc prep */
+	if (!list_empty(&core->cmdq_backlog.list)) {
+		d_vpr_h("%s: cmdq backlog pending\n", __func__);
+		return -EBUSY;
+	}
+
 	__flush_debug_queue(core, (!force ? core->packet : NULL), core->packet_size);
 
+	/* hand back slices the llcc policy dropped while firmware was busy */
+	if (!core->sys_cache.enable && core->dt->sys_cache_res_set) {
+		rc = __release_subcaches(core);
+		if (rc)
+			d_vpr_e("%s: failed to release subcaches %d\n", __func__, rc);
+		else
+			core->sys_cache.releases++;
+	}
+
 	rc = call_venus_op(core, prepare_pc, core);
 	if (rc)
 		goto skip_power_off;
@@ -1926,6 +2284,10 @@ static int __enable_subcaches(struct msm_vidc_core *core)
 	if (msm_vidc_syscache_disable || !is_sys_cache_present(core))
 		return 0;
 
+	/* slices stay with cpu and gpu until the session mix benefits */
+	if (!core->sys_cache.enable)
+		return 0;
+
 	/* Activate subcaches */
 	venus_hfi_for_each_subcache(core, sinfo) {
 		rc = llcc_slice_activate(sinfo->subcache);
@@ -1953,6 +2315,7 @@ err_activate_fail:
 static int __set_subcaches(struct msm_vidc_core *core)
 {
 	int rc = 0;
+	u32 c = 0;
 	struct subcache_info *sinfo;
 	struct hfi_buffer buf;
 
@@ -1966,6 +2329,14 @@ static int __set_subcaches(struct msm_vidc_core *core)
 		return 0;
 	}
 
+	/* nothing activated under the current llcc policy */
+	venus_hfi_for_each_subcache(core, sinfo) {
+		if (sinfo->isactive)
+			c++;
+	}
+	if (!c)
+		return 0;
+
 	rc = hfi_create_header(core->packet, core->packet_size,
 		0, core->header_id++);
 	if (rc)
@@ -2111,6 +2482,7 @@ err_tzbsp_suspend:
 static int __resume(struct msm_vidc_core *core)
 {
 	int rc = 0;
+	u64 resume_ns, step_ns;
 
 	if (!core) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -2127,6 +2499,7 @@ static int __resume(struct msm_vidc_core *core)
 		return rc;
 
 	d_vpr_h("Resuming from power collapse\n");
+	resume_ns = ktime_get_ns();
 	core->handoff_done = false;
 	core->hw_power_control = false;
 
@@ -2135,6 +2508,7 @@ static int __resume(struct msm_vidc_core *core)
 		d_vpr_e("Failed to power on venus\n");
 		goto err_venus_power_on;
 	}
+	step_ns = __trace_power_step(core, "power_on", resume_ns);
 
 	/* Reboot the firmware */
 	rc = __tzbsp_set_video_state(TZBSP_VIDEO_STATE_RESUME);
@@ -2142,6 +2516,7 @@ static int __resume(struct msm_vidc_core *core)
 		d_vpr_e("Failed to resume video core %d\n", rc);
 		goto err_set_video_state;
 	}
+	step_ns = __trace_power_step(core, "tzbsp_resume", step_ns);
 
 	/*
 	 * Hand off control of regulators to h/w _after_ loading fw.
@@ -2159,6 +2534,7 @@ static int __resume(struct msm_vidc_core *core)
 		d_vpr_e("Failed to reset venus core\n");
 		goto err_reset_core;
 	}
+	step_ns = __trace_power_step(core, "boot_firmware", step_ns);
 
 	__sys_set_debug(core, (msm_vidc_debug & FW_LOGMASK) >> FW_LOGSHIFT);
 
@@ -2168,6 +2544,7 @@ static int __resume(struct msm_vidc_core *core)
 		goto err_reset_core;
 	}
 	__set_subcaches(core);
+	step_ns = __trace_power_step(core, "subcaches", step_ns);
 
 	rc = __sys_set_power_control(core, true);
 	if (rc) {
@@ -2176,6 +2553,8 @@ static int __resume(struct msm_vidc_core *core)
 		rc = 0;
 	}
 
+	__trace_power_step(core, "resume", resume_ns);
+	__pc_update_residency(core, ktime_get_ns() - resume_ns);
 	d_vpr_h("Resumed from power collapse\n");
 exit:
 	/* Don't reset skip_pc_count for SYS_PC_PREP cmd */
@@ -2213,6 +2592,8 @@ void venus_hfi_interface_queues_deinit(struct msm_vidc_core *core)
 
 	d_vpr_h("%s()\n", __func__);
 
+	flush_work(&core->fw_dump.work);
+
 	if (!core->iface_q_table.align_virtual_addr) {
 		d_vpr_h("%s: queues already deallocated\n", __func__);
 		return;
@@ -2583,7 +2964,7 @@ void __unload_fw(struct msm_vidc_core *core)
 	d_vpr_h("%s done\n", __func__);
 }
 
-static int __response_handler(struct msm_vidc_core *core)
+static int __response_handler(struct msm_vidc_core *core, u32 *num_msgs)
 {
 	int rc = 0;
 
@@ -2597,6 +2978,7 @@ static int __response_handler(struct msm_vidc_core *core)
 
 	memset(core->response_packet, 0, core->packet_size);
 	while (!__iface_msgq_read(core, core->response_packet)) {
+		(*num_msgs)++;
 		rc = handle_response(core, core->response_packet);
 		if (rc)
 			continue;
@@ -2606,22 +2988,117 @@ static int __response_handler(struct msm_vidc_core *core)
 		memset(core->response_packet, 0, core->packet_size);
 	}
 
+	if (*num_msgs)
+		core->pc_predictor.idle_start_ns = ktime_get_ns();
 	__schedule_power_collapse_work(core);
 	__flush_debug_queue(core, core->response_packet, core->packet_size);
 
 	return rc;
 }
 
+static void __irq_stats_update(struct msm_vidc_core *core, u32 num_msgs)
+{
+	struct msm_vidc_irq_stats *stats = &core->irq_stats;
+	u64 now, elapsed;
+
+	now = ktime_get_ns();
+	if (!stats->window_start)
+		stats->window_start = now;
+
+	stats->total_irqs++;
+	stats->total_msgs += num_msgs;
+	stats->window_irqs++;
+	stats->window_msgs += num_msgs;
+
+	elapsed = now - stats->window_start;
+	if (elapsed < NSEC_PER_SEC)
+		return;
+
+	stats->irq_rate = div64_u64((u64)stats->window_irqs * NSEC_PER_SEC, elapsed);
+	stats->msg_rate = div64_u64((u64)stats->window_msgs * NSEC_PER_SEC, elapsed);
+	stats->msgs_per_irq = (stats->window_msgs * 100) / stats->window_irqs;
+	stats->window_start = now;
+	stats->window_irqs = 0;
+	stats->window_msgs = 0;
+}
+
+/*
+ * Returns the polling window in usec the isr thread may spend on msgq,
+ * or zero to go back to interrupts right away. Polling kicks in only
+ * above IRQ_POLL_MSG_RATE and is capped to 1/8th of the shortest frame
+ * period of the active realtime sessions.
+ */
+static u32 __irq_poll_window_us(struct msm_vidc_core *core)
+{
+	struct msm_vidc_inst *inst;
+	u32 window_us, fps, max_fps = 0;
+
+	if (!core->capabilities[IRQ_POLL_MSG_RATE].value ||
+		core->irq_stats.msg_rate < core->capabilities[IRQ_POLL_MSG_RATE].value)
+		return 0;
+
+	window_us = core->capabilities[IRQ_POLL_BUDGET].value *
+		core->capabilities[IRQ_POLL_INTERVAL_US].value;
+
+	core_lock(core, __func__);
+	list_for_each_entry(inst, &core->instances, list) {
+		/* latency sensitive clients always get the interrupt path */
+		if (is_lowlatency_session(inst)) {
+			window_us = 0;
+			break;
+		}
+		if (!is_realtime_session(inst))
+			continue;
+		fps = max(msm_vidc_get_frame_rate(inst),
+			msm_vidc_get_operating_rate(inst));
+		max_fps = max(max_fps, fps);
+	}
+	core_unlock(core, __func__);
+
+	if (window_us && max_fps)
+		window_us = min_t(u32, window_us, USEC_PER_SEC / (max_fps * 8));
+
+	return window_us;
+}
+
 irqreturn_t venus_hfi_isr(int irq, void *data)
 {
+	struct msm_vidc_core *core = data;
+
+	if (core)
+		core->irq_ts = ktime_get_ns();
 	disable_irq_nosync(irq);
 	return IRQ_WAKE_THREAD;
 }
 
+/* runs in the isr thread, so policy changes apply to current */
+static void __update_irq_thread_sched(struct msm_vidc_core *core)
+{
+	core->irq_sched_update = false;
+
+	switch (core->irq_sched) {
+	case MSM_VIDC_IRQ_SCHED_NORMAL:
+		sched_set_normal(current, 0);
+		break;
+	case MSM_VIDC_IRQ_SCHED_FIFO_LOW:
+		sched_set_fifo_low(current);
+		break;
+	case MSM_VIDC_IRQ_SCHED_DEFAULT:
+	case MSM_VIDC_IRQ_SCHED_FIFO:
+	default:
+		/* same as what the irq core gives threaded handlers */
+		sched_set_fifo(current);
+		break;
+	}
+	d_vpr_h("%s: core%u irq thread sched %u on cpu %d\n",
+		__func__, core->id, core->irq_sched, raw_smp_processor_id());
+}
+
 irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 {
 	struct msm_vidc_core *core = data;
-	int num_responses = 0, rc = 0;
+	u32 num_msgs = 0, polled, interval_us, window_us, spent_us = 0;
+	int rc = 0;
 
 	d_vpr_l("%s()\n", __func__);
 	if (!core) {
@@ -2629,6 +3106,11 @@ irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 		return IRQ_NONE;
 	}
 
+	if (core->irq_sched_update)
+		__update_irq_thread_sched(core);
+	trace_msm_vidc_irq_latency("irq_thread", core->id,
+		div_u64(ktime_get_ns() - core->irq_ts, NSEC_PER_USEC));
+
 	core_lock(core, __func__);
 	rc = __resume(core);
 	if (rc) {
@@ -2639,7 +3121,36 @@ irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 	call_venus_op(core, clear_interrupt, core);
 	core_unlock(core, __func__);
 
-	num_responses = __response_handler(core);
+	rc = __response_handler(core, &num_msgs);
+
+	/* under heavy message rate, poll msgq a bit before re-arming irq */
+	window_us = __irq_poll_window_us(core);
+	interval_us = core->capabilities[IRQ_POLL_INTERVAL_US].value;
+	while (!rc && interval_us && spent_us + interval_us <= window_us) {
+		usleep_range(interval_us, interval_us + interval_us / 4);
+		spent_us += interval_us;
+
+		core_lock(core, __func__);
+		if (core->state != MSM_VIDC_CORE_INIT || __resume(core)) {
+			core_unlock(core, __func__);
+			break;
+		}
+		call_venus_op(core, clear_interrupt, core);
+		core_unlock(core, __func__);
+
+		polled = 0;
+		rc = __response_handler(core, &polled);
+		if (!polled)
+			break;
+		num_msgs += polled;
+		core->irq_stats.poll_count++;
+	}
+	__irq_stats_update(core, num_msgs);
+
+	/* firmware consumed commands, push parked packets */
+	core_lock(core, __func__);
+	__cmdq_backlog_drain(core);
+	core_unlock(core, __func__);
 
 exit:
 	if (!call_venus_op(core, watchdog, core, core->intr_status))
@@ -2652,6 +3163,7 @@ void venus_hfi_pm_work_handler(struct work_struct *work)
 {
 	int rc = 0;
 	struct msm_vidc_core *core;
+	bool fast;
 
 	core = container_of(work, struct msm_vidc_core, pm_work.work);
 	if (!core) {
@@ -2680,12 +3192,19 @@ void venus_hfi_pm_work_handler(struct work_struct *work)
 		goto unlock;
 	}
 
+	fast = core->pc_predictor.fast_pending;
 	rc = __power_collapse(core, false);
 	switch (rc) {
 	case 0:
 		core->skip_pc_count = 0;
 		/* Cancel pending delayed works if any */
 		__cancel_power_collapse_work(core);
+		if (core->power_enabled)
+			break;
+		core->pc_predictor.collapse_ns = ktime_get_ns();
+		core->pc_predictor.collapse_count++;
+		if (fast)
+			core->pc_predictor.fast_count++;
 		d_vpr_h("%s: power collapse successful!\n", __func__);
 		break;
 	case -EBUSY:
@@ -2694,6 +3213,16 @@ void venus_hfi_pm_work_handler(struct work_struct *work)
 		__schedule_power_collapse_work(core);
 		break;
 	case -EAGAIN:
+		if (fast) {
+			/* early attempt found fw busy, not a fw failure */
+			core->pc_predictor.mispredict_busy++;
+			if (core->pc_predictor.backoff < PC_MAX_BACKOFF)
+				core->pc_predictor.backoff++;
+			core->pc_predictor.gap_us = 0;
+			d_vpr_h("%s: early power collapse refused\n", __func__);
+			__schedule_power_collapse_work(core);
+			break;
+		}
 		core->skip_pc_count++;
 		d_vpr_e("%s: retry power collapse (count %d)\n",
 			__func__, core->skip_pc_count);
@@ -2751,6 +3280,9 @@ int venus_hfi_core_init(struct msm_vidc_core *core)
 	if (rc)
 		return rc;
 
+	/* previous crash dump still reads the fw region and queues */
+	flush_work(&core->fw_dump.work);
+
 	rc = venus_hfi_interface_queues_init(core);
 	if (rc)
 		goto error;
@@ -2814,6 +3346,7 @@ int venus_hfi_core_deinit(struct msm_vidc_core *core, bool force)
 	if (core->state == MSM_VIDC_CORE_DEINIT)
 		return 0;
 	__resume(core);
+	venus_hfi_cmdq_backlog_flush(core);
 	__flush_debug_queue(core, (!force ? core->packet : NULL), core->packet_size);
 	__disable_subcaches(core);
 	__unload_fw(core);
@@ -3572,8 +4105,8 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 	}
 
 	batch_size = capability->cap[SUPER_FRAME].value;
-	frame_size = call_session_op(core, buffer_size, inst, MSM_VIDC_BUF_INPUT);
-	meta_size = call_session_op(core, buffer_size, inst, MSM_VIDC_BUF_INPUT_META);
+	frame_size = inst->encode_batch.frame_size;
+	meta_size = inst->encode_batch.meta_size;
 	ts_delta_us = 1000000 / (capability->cap[FRAME_RATE].value >> 16);
 
 	/* Sanitize super yuv buffer */
@@ -3696,6 +4229,31 @@ static int venus_hfi_add_pending_packets(struct msm_vidc_inst *inst)
 	return rc;
 }
 
+int venus_hfi_raise_doorbell(struct msm_vidc_core *core)
+{
+	int rc = 0;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	core_lock(core, __func__);
+	if (!__core_in_valid_state(core))
+		goto unlock;
+
+	rc = __resume(core);
+	if (rc) {
+		d_vpr_e("%s: Power on failed\n", __func__);
+		goto unlock;
+	}
+	call_venus_op(core, raise_interrupt, core);
+
+unlock:
+	core_unlock(core, __func__);
+	return rc;
+}
+
 int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buffer, struct msm_vidc_buffer *metabuf)
 {
@@ -3782,9 +4340,16 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 	if (rc)
 		goto unlock;
 
-	rc = __iface_cmdq_write(inst->core, inst->packet);
+	/*
+	 * batched encode input raises interrupt only for the last buffer,
+	 * batched qbuf ioctl rings the doorbell once at the end
+	 */
+	rc = __iface_cmdq_write_intr(inst->core, inst->packet,
+		!inst->encode_batch.hold_intr && !inst->qbuf_batch.owner);
 	if (rc)
 		goto unlock;
+	if (inst->qbuf_batch.owner)
+		inst->qbuf_batch.held++;
 
 unlock:
 	core_unlock(core, __func__);
@@ -3898,6 +4463,56 @@ exit:
 	return rc;
 }
 
+int venus_hfi_set_sys_cache(struct msm_vidc_inst *inst, bool enable)
+{
+	int rc = 0;
+	struct msm_vidc_core *core;
+
+	if (!inst || !inst->core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+	core = inst->core;
+
+	if (msm_vidc_syscache_disable || !is_sys_cache_present(core))
+		return 0;
+
+	core_lock(core, __func__);
+	if (core->sys_cache.enable == enable)
+		goto exit;
+	core->sys_cache.enable = enable;
+
+	/* power collapsed: the next resume activates per the new policy */
+	if (!core->power_enabled || !__core_in_valid_state(core))
+		goto exit;
+
+	/*
+	 * firmware may still be using the slices for queued frames, so a
+	 * release is only recorded here and sent at the next power collapse
+	 */
+	if (!enable) {
+		i_vpr_h(inst, "%s: llcc release deferred, est ddr saving %llu kBps\n",
+			__func__, core->sys_cache.ddr_saved);
+		goto exit;
+	}
+
+	/* release still pending: slices are active and set to firmware */
+	if (core->dt->sys_cache_res_set)
+		goto exit;
+
+	rc = __enable_subcaches(core);
+	if (!rc)
+		rc = __set_subcaches(core);
+	if (!rc)
+		core->sys_cache.activations++;
+	i_vpr_h(inst, "%s: llcc slices activated, est ddr saving %llu kBps, rc %d\n",
+		__func__, core->sys_cache.ddr_saved, rc);
+
+exit:
+	core_unlock(core, __func__);
+	return rc;
+}
+
 int venus_hfi_set_ir_period(struct msm_vidc_inst *inst, u32 ir_type,
 	enum msm_vidc_inst_capability_type cap_id)
 {
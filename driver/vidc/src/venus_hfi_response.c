@@ -14,10 +14,10 @@
 #include "msm_vidc_control.h"
 #include "msm_vidc_memory.h"
 #include "msm_vidc_fence.h"
+#include "msm_vidc_buffer.h"
 
 #define in_range(range, val) (((range.begin) < (val)) && ((range.end) > (val)))
 
-extern struct msm_vidc_core *g_core;
 struct msm_vidc_core_hfi_range {
 	u32 begin;
 	u32 end;
@@ -395,23 +395,161 @@ static int handle_session_error(struct msm_vidc_inst *inst,
 	return rc;
 }
 
+/* dump kept as page sized chunks, all-zero chunks are not stored */
+struct msm_vidc_coredump {
+	size_t                size;
+	u32                   nr_chunks;
+	void                 *chunks[];
+};
+
+static ssize_t fw_coredump_read(char *buffer, loff_t offset, size_t count,
+	void *data, size_t datalen)
+{
+	struct msm_vidc_coredump *dump = data;
+	size_t done = 0, off, len;
+	u32 idx;
+
+	if (offset >= datalen)
+		return 0;
+	count = min_t(size_t, count, datalen - offset);
+
+	while (done < count) {
+		idx = (offset + done) >> PAGE_SHIFT;
+		off = (offset + done) & ~PAGE_MASK;
+		len = min_t(size_t, count - done, PAGE_SIZE - off);
+		if (dump->chunks[idx])
+			memcpy(buffer + done, (char *)dump->chunks[idx] + off, len);
+		else
+			memset(buffer + done, 0, len);
+		done += len;
+	}
+
+	return done;
+}
+
+static void fw_coredump_free(void *data)
+{
+	struct msm_vidc_coredump *dump = data;
+	u32 i;
+
+	for (i = 0; i < dump->nr_chunks; i++)
+		free_page((unsigned long)dump->chunks[i]);
+	kvfree(dump);
+}
+
+static int fw_coredump_copy(struct msm_vidc_coredump *dump, size_t pos,
+	const void *src, size_t size)
+{
+	size_t off = 0, len;
+	void *page = NULL;
+	u32 idx;
+
+	/* callers keep every section page aligned */
+	while (off < size) {
+		idx = (pos + off) >> PAGE_SHIFT;
+		len = min_t(size_t, size - off, PAGE_SIZE);
+		if (!page) {
+			page = (void *)__get_free_page(GFP_KERNEL);
+			if (!page)
+				return -ENOMEM;
+		}
+		memcpy(page, (const char *)src + off, len);
+		if (len < PAGE_SIZE)
+			memset((char *)page + len, 0, PAGE_SIZE - len);
+		/* idle fw memory is mostly zero, keep the page for the next chunk */
+		if (memchr_inv(page, 0, PAGE_SIZE)) {
+			dump->chunks[idx] = page;
+			page = NULL;
+		}
+		off += len;
+	}
+	free_page((unsigned long)page);
+
+	return 0;
+}
+
+void fw_coredump_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+	struct msm_vidc_fw_dump *fw_dump;
+	struct msm_vidc_coredump *dump;
+	size_t fw_size, total_size;
+	u32 nr_chunks;
+	int rc = 0;
+
+	fw_dump = container_of(work, struct msm_vidc_fw_dump, work);
+	core = container_of(fw_dump, struct msm_vidc_core, fw_dump);
+
+	fw_size = min_t(size_t, PAGE_ALIGN(fw_dump->mem_size),
+		(size_t)core->capabilities[FW_DUMP_MAX_SIZE].value * SZ_1M);
+	total_size = fw_size + PAGE_ALIGN(TOTAL_QSIZE) + PAGE_ALIGN(ALIGNED_SFR_SIZE);
+	nr_chunks = total_size >> PAGE_SHIFT;
+
+	dump = kvzalloc(struct_size(dump, chunks, nr_chunks), GFP_KERNEL);
+	if (!dump)
+		goto unmap;
+	dump->size = total_size;
+	dump->nr_chunks = nr_chunks;
+
+	/* firmware memory, then queues(cmd, msg, dbg) with headers, then sfr */
+	rc = fw_coredump_copy(dump, 0, fw_dump->mem_va,
+		min(fw_size, fw_dump->mem_size));
+	if (!rc)
+		rc = fw_coredump_copy(dump, fw_size,
+			core->iface_q_table.align_virtual_addr, TOTAL_QSIZE);
+	if (!rc)
+		rc = fw_coredump_copy(dump, fw_size + PAGE_ALIGN(TOTAL_QSIZE),
+			core->sfr.align_virtual_addr, ALIGNED_SFR_SIZE);
+	if (rc) {
+		d_vpr_e("%s: core%u dump copy failed %d\n", __func__, core->id, rc);
+		fw_coredump_free(dump);
+		goto unmap;
+	}
+
+	dev_coredumpm(&core->pdev->dev, THIS_MODULE, dump, total_size,
+		GFP_KERNEL, fw_coredump_read, fw_coredump_free);
+	d_vpr_h("%s: core%u fw dump of %zu bytes ready\n",
+		__func__, core->id, total_size);
+
+unmap:
+	memunmap(fw_dump->mem_va);
+	fw_dump->mem_va = NULL;
+}
+
+/*
+ * Map the firmware region and hand the copy off to fw_dump.work, so that
+ * core deinit and session error reporting do not wait for it. The next
+ * fw load flushes the work before reusing the region and queues.
+ */
 void fw_coredump(struct msm_vidc_core *core)
 {
 	int rc = 0;
 	struct platform_device *pdev;
 	struct device_node *node = NULL;
 	struct resource res = {0};
-	phys_addr_t mem_phys = 0;
-	size_t res_size = 0;
-	void *mem_va = NULL;
-	char *data = NULL, *dump = NULL;
-	u64 total_size;
+	struct msm_vidc_fw_dump *fw_dump;
+	u64 now;
 
-	if (!core) {
+	if (!core || !core->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
 	}
 	pdev = core->pdev;
+	fw_dump = &core->fw_dump;
+
+	/* error storms would otherwise dump back to back */
+	now = ktime_get_ns();
+	if (fw_dump->last_ns && now - fw_dump->last_ns <
+			(u64)core->capabilities[FW_DUMP_INTERVAL].value * NSEC_PER_SEC) {
+		fw_dump->skip_count++;
+		d_vpr_h("%s: core%u fw dump rate limited\n", __func__, core->id);
+		return;
+	}
+
+	if (work_pending(&fw_dump->work) || fw_dump->mem_va) {
+		d_vpr_h("%s: core%u fw dump in progress\n", __func__, core->id);
+		return;
+	}
 
 	node = of_parse_phandle(pdev->dev.of_node, "memory-region", 0);
 	if (!node) {
@@ -427,36 +565,16 @@ void fw_coredump(struct msm_vidc_core *core)
 		return;
 	}
 
-	mem_phys = res.start;
-	res_size = (size_t)resource_size(&res);
-
-	mem_va = memremap(mem_phys, res_size, MEMREMAP_WC);
-	if (!mem_va) {
+	fw_dump->mem_size = (size_t)resource_size(&res);
+	fw_dump->mem_va = memremap(res.start, fw_dump->mem_size, MEMREMAP_WC);
+	if (!fw_dump->mem_va) {
 		d_vpr_e("%s: unable to remap firmware memory\n", __func__);
 		return;
 	}
-	total_size = res_size + TOTAL_QSIZE + ALIGNED_SFR_SIZE;
-
-	data = vmalloc(total_size);
-	if (!data) {
-		memunmap(mem_va);
-		return;
-	}
-	dump = data;
-
-	/* copy firmware dump */
-	memcpy(data, mem_va, res_size);
-	memunmap(mem_va);
-
-	/* copy queues(cmd, msg, dbg) dump(along with headers) */
-	data += res_size;
-	memcpy(data, (char *)core->iface_q_table.align_virtual_addr, TOTAL_QSIZE);
 
-	/* copy sfr dump */
-	data += TOTAL_QSIZE;
-	memcpy(data, (char *)core->sfr.align_virtual_addr, ALIGNED_SFR_SIZE);
-
-	dev_coredumpv(&pdev->dev, dump, total_size, GFP_KERNEL);
+	fw_dump->last_ns = now;
+	fw_dump->count++;
+	queue_work(system_unbound_wq, &fw_dump->work);
 }
 
 int handle_system_error(struct msm_vidc_core *core,
@@ -483,7 +601,7 @@ int handle_system_error(struct msm_vidc_core *core,
 		}
 	}
 
-	msm_vidc_core_deinit(core, true);
+	msm_vidc_core_recover(core);
 
 	return 0;
 }
@@ -791,15 +909,13 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 	int rc = 0;
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
 	bool found;
 
-	if (!inst || !buffer || !inst->capabilities || !inst->core) {
+	if (!inst || !buffer || !inst->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT, __func__);
 	if (!buffers)
 		return -EINVAL;
@@ -820,7 +936,7 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 
 	/* attach dequeued flag for, only last frame in the batch */
 	if (msm_vidc_is_super_buffer(inst)) {
-		frame_size = call_session_op(core, buffer_size, inst, MSM_VIDC_BUF_INPUT);
+		frame_size = inst->encode_batch.frame_size;
 		batch_size = inst->capabilities->cap[SUPER_FRAME].value;
 		if (!frame_size || !batch_size) {
 			i_vpr_e(inst, "%s: invalid size: frame %u, batch %u\n",
@@ -839,6 +955,10 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 		return 0;
 	}
 
+	/* track client filled bitstream size before firmware overwrites it */
+	if (is_decode_session(inst))
+		msm_vidc_update_bitstream_size(inst, buf, false);
+
 	buf->data_size = buffer->data_size;
 	buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
 	buf->attr |= MSM_VIDC_ATTR_DEQUEUED;
@@ -942,8 +1062,13 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 				fatal = true;
 			}
 
-			/* overflow not expected for cbr_cfr session */
-			if (!buffer->data_size && inst->hfi_rc_type == HFI_RC_CBR_CFR) {
+			/*
+			 * overflow not expected for cbr_cfr session, unless this
+			 * buffer was shrunk by adaptive sizing. Then the frame is
+			 * dropped and client is asked to reallocate worst case size.
+			 */
+			if (!buffer->data_size && inst->hfi_rc_type == HFI_RC_CBR_CFR &&
+				!msm_vidc_is_bitstream_shrunk(inst, buf)) {
 				i_vpr_e(inst, "%s: overflow detected for cbr_cfr session\n",
 					__func__);
 				fatal = true;
@@ -951,6 +1076,9 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 		}
 		if (fatal)
 			msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
+		else
+			msm_vidc_update_bitstream_size(inst, buf,
+				inst->hfi_frame_info.overflow);
 	}
 
 	/*
@@ -1022,6 +1150,9 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	if (!is_image_session(inst) && is_decode_session(inst) && buf->data_size)
 		msm_vidc_update_timestamp_rate(inst, buf->timestamp);
 
+	if (is_image_encode_session(inst))
+		msm_vidc_image_stats_fbd(inst, buf);
+
 	/* update output buffer timestamp, if ts_reorder is enabled */
 	if (is_ts_reorder_allowed(inst) && buf->data_size)
 		msm_vidc_ts_reorder_get_first_timestamp(inst, &buf->timestamp);
@@ -1042,15 +1173,13 @@ static int handle_input_metadata_buffer(struct msm_vidc_inst *inst,
 	int rc = 0;
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
 	bool found;
 
-	if (!inst || !buffer || !inst->capabilities || !inst->core) {
+	if (!inst || !buffer || !inst->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT_META, __func__);
 	if (!buffers)
 		return -EINVAL;
@@ -1070,7 +1199,7 @@ static int handle_input_metadata_buffer(struct msm_vidc_inst *inst,
 	}
 	/* attach dequeued flag for, only last frame in the batch */
 	if (msm_vidc_is_super_buffer(inst)) {
-		frame_size = call_session_op(core, buffer_size, inst, MSM_VIDC_BUF_INPUT_META);
+		frame_size = inst->encode_batch.meta_size;
 		batch_size = inst->capabilities->cap[SUPER_FRAME].value;
 		if (!frame_size || !batch_size) {
 			i_vpr_e(inst, "%s: invalid size: frame %u, batch %u\n",
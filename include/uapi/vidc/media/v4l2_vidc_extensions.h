@@ -280,6 +280,18 @@ enum v4l2_h264_encode_delivery_mode {
 #define V4L2_CID_MPEG_VIDC_EARLY_NOTIFY_LINE_COUNT                            \
 	(V4L2_CID_MPEG_VIDC_BASE + 0x45)
 
+/* Shrink bitstream buffer size(sizeimage) based on observed frame sizes */
+#define V4L2_CID_MPEG_VIDC_ADAPTIVE_BITSTREAM_SIZE                            \
+	(V4L2_CID_MPEG_VIDC_BASE + 0x46)
+
+/* Max latency(ms) decode batching may add to a session, 0 for default */
+#define V4L2_CID_MPEG_VIDC_DECODE_BATCH_LATENCY                               \
+	(V4L2_CID_MPEG_VIDC_BASE + 0x48)
+
+/* Enable driver managed input batching for high frame rate encode */
+#define V4L2_CID_MPEG_VIDC_ENC_AUTO_BATCH                                     \
+	(V4L2_CID_MPEG_VIDC_BASE + 0x49)
+
 /* add new controls above this line */
 /* Deprecate below controls once availble in gki and gsi bionic header */
 #ifndef V4L2_CID_MPEG_VIDEO_BASELAYER_PRIORITY_ID
@@ -470,6 +482,57 @@ enum meta_picture_type {
 
 /* vendor events end */
 
+/* vendor ioctls start */
+
+#define MSM_VIDC_MAX_BUF_BATCH           32
+
+/*
+ * struct v4l2_vidc_buf_batch - queue or dequeue several buffers in one call
+ * @count: in: number of entries in @buffers, out: number of entries done
+ * @buffers: user pointer to an array of struct v4l2_buffer. Entries may mix
+ *           INPUT/OUTPUT/META ports, multi-planar entries carry their own
+ *           m.planes user pointer as with VIDIOC_QBUF.
+ *
+ * Processing stops at the first failing entry. The call fails only if the
+ * first entry does, otherwise @count tells how far it got.
+ * VIDIOC_VIDC_DQBUF_BATCH never blocks and stops at the first empty queue.
+ */
+struct v4l2_vidc_buf_batch {
+	__u32                                   count;
+	__u32                                   reserved[3];
+	__u64                                   buffers;
+};
+
+#define VIDIOC_VIDC_QBUF_BATCH \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 0, struct v4l2_vidc_buf_batch)
+#define VIDIOC_VIDC_DQBUF_BATCH \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct v4l2_vidc_buf_batch)
+
+/* vendor ioctls end */
+
+/* vendor events */
+/*
+ * Firmware restarted and the session was reopened with its configuration
+ * replayed. Buffers that were with firmware have been queued again, output
+ * resumes from the next sync frame.
+ */
+#define V4L2_EVENT_VIDC_RECOVERED        (V4L2_EVENT_PRIVATE_START + 1)
+/*
+ * Realtime load exceeds what the core can clock and the session lost its
+ * deadline priority, or got it back. u.data[0] is 1 when shed, 0 when
+ * restored; u.data[1] suggests how the client can help the core catch up.
+ */
+#define V4L2_EVENT_VIDC_LOAD_SHED        (V4L2_EVENT_PRIVATE_START + 2)
+#define V4L2_VIDC_SHED_SKIP_NONREF       0x1 /* decode: drop non-reference frames */
+#define V4L2_VIDC_SHED_RAISE_QP          0x2 /* encode: raise qp or lower the rate */
+/*
+ * A bitstream buffer shrunk by adaptive sizing was too small for a frame.
+ * sizeimage is back to the worst case size; u.data[0] is the v4l2 buffer
+ * type and u.data[1] the new sizeimage. Client should reallocate buffers
+ * of that port, the overflowed encoder frame is lost.
+ */
+#define V4L2_EVENT_VIDC_BITSTREAM_SIZE   (V4L2_EVENT_PRIVATE_START + 3)
+
 /* Default metadata size (align to 4KB) */
 #define MSM_VIDC_METADATA_SIZE           (4 * 4096) /* 16 KB */
 #define ENCODE_INPUT_METADATA_SIZE       (512 * 4096) /* 2 MB */